@@ -0,0 +1,156 @@
+// FFT throughput benchmark across the supported FFT sizes
+//
+// compares fft_processor (real-input path) against the previous approach of
+// packing real samples into a complex buffer and running a full kiss_fft, then
+// times every compiled-in FFT backend on its own (including the fixed_fft<N>
+// kernels), then batched multi-frame throughput on one thread and on all of them
+
+#include "dsp/fft_backend.h"
+#include "dsp/fft_batch.h"
+#include "dsp/fft_processor.h"
+#include "kiss_fft.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	using clock_type = std::chrono::steady_clock;
+
+	constexpr size_t k_sizes[] = { pm::k_fft_size_1024, pm::k_fft_size_2048, pm::k_fft_size_4096, pm::k_fft_size_8192, pm::k_fft_size_16384 };
+
+	// keep the optimiser from discarding results
+	volatile float g_sink = 0.0f;
+
+	// aim for roughly the same amount of work per size
+	size_t iterations_for( size_t fft_size )
+	{
+		return std::max< size_t >( 200, ( 1u << 24 ) / fft_size );
+	}
+
+	double bench_complex( const std::vector< float >& signal, size_t fft_size )
+	{
+		kiss_fft_cfg cfg = kiss_fft_alloc( static_cast< int >( fft_size ), 0, nullptr, nullptr );
+		std::vector< kiss_fft_cpx > in( fft_size ), out( fft_size );
+		std::vector< float > mags( fft_size / 2 );
+
+		const size_t iterations = iterations_for( fft_size );
+		auto start              = clock_type::now( );
+
+		for ( size_t it = 0; it < iterations; ++it ) {
+			for ( size_t i = 0; i < fft_size; ++i ) {
+				in[ i ].r = signal[ i ];
+				in[ i ].i = 0.0f;
+			}
+			kiss_fft( cfg, in.data( ), out.data( ) );
+			for ( size_t i = 0; i < fft_size / 2; ++i ) {
+				mags[ i ] = std::sqrt( out[ i ].r * out[ i ].r + out[ i ].i * out[ i ].i );
+			}
+			g_sink = g_sink + mags[ it % mags.size( ) ];
+		}
+
+		double elapsed = std::chrono::duration< double >( clock_type::now( ) - start ).count( );
+		kiss_fft_free( cfg );
+		return elapsed / static_cast< double >( iterations );
+	}
+
+	double bench_processor( const std::vector< float >& signal, size_t fft_size )
+	{
+		pm::fft_processor fft( fft_size );
+		fft.set_smoothing( 0.0f );
+
+		const size_t iterations = iterations_for( fft_size );
+		auto start              = clock_type::now( );
+
+		for ( size_t it = 0; it < iterations; ++it ) {
+			fft.process( signal.data( ), fft_size );
+			g_sink = g_sink + fft.get_magnitude( it % fft.get_bin_count( ) );
+		}
+
+		double elapsed = std::chrono::duration< double >( clock_type::now( ) - start ).count( );
+		return elapsed / static_cast< double >( iterations );
+	}
+
+	// frames per second through fft_batch, 75% overlap
+	double bench_batch( const std::vector< float >& signal, size_t fft_size, size_t thread_count )
+	{
+		const size_t hop    = fft_size / 4;
+		const size_t frames = ( signal.size( ) - fft_size ) / hop + 1;
+
+		pm::fft_batch batch( fft_size, thread_count );
+		std::vector< float > mags( frames * batch.get_bin_count( ) );
+
+		const size_t iterations = std::max< size_t >( 4, ( 1u << 26 ) / ( frames * fft_size ) );
+		auto start              = clock_type::now( );
+
+		for ( size_t it = 0; it < iterations; ++it ) {
+			batch.process( signal.data( ), hop, frames, mags.data( ) );
+			g_sink = g_sink + mags[ it % mags.size( ) ];
+		}
+
+		double elapsed = std::chrono::duration< double >( clock_type::now( ) - start ).count( );
+		return static_cast< double >( frames * iterations ) / elapsed;
+	}
+
+} // namespace
+
+int main( )
+{
+	std::mt19937 rng( 1234 );
+	std::uniform_real_distribution< float > dist( -1.0f, 1.0f );
+
+	// long enough for a few hundred overlapping frames at every size
+	std::vector< float > signal( pm::k_fft_size_16384 * 64 );
+	for ( auto& s : signal ) {
+		s = dist( rng );
+	}
+
+	printf( "%8s %16s %16s %10s\n", "size", "complex (us)", "processor (us)", "speedup" );
+
+	for ( size_t fft_size : k_sizes ) {
+		double t_complex   = bench_complex( signal, fft_size ) * 1e6;
+		double t_processor = bench_processor( signal, fft_size ) * 1e6;
+		printf( "%8zu %16.2f %16.2f %9.2fx\n", fft_size, t_complex, t_processor, t_complex / t_processor );
+	}
+
+	// one real + one complex transform per iteration, as in select_fastest_backends( )
+	const pm::fft_backend_type backends[] = { pm::fft_backend_type::kissfft, pm::fft_backend_type::pocketfft, pm::fft_backend_type::fftw,
+	                                          pm::fft_backend_type::fixed };
+
+	printf( "\n%8s", "size" );
+	for ( auto backend : backends ) {
+		printf( " %14s", pm::get_fft_backend_name( backend ) );
+	}
+	printf( "   (us, real + complex)\n" );
+
+	for ( size_t fft_size : k_sizes ) {
+		printf( "%8zu", fft_size );
+		for ( auto backend : backends ) {
+			double t = pm::measure_fft_backend( backend, fft_size, iterations_for( fft_size ) );
+			if ( t < 0.0 ) {
+				printf( " %14s", "n/a" );
+			} else {
+				printf( " %14.2f", t * 1e-3 );
+			}
+		}
+		printf( "\n" );
+	}
+
+	pm::fft_batch probe( pm::k_fft_size_1024 );
+	const size_t threads = probe.get_thread_count( );
+
+	printf( "\n%8s %16s %16s %10s\n", "size", "batch 1t (f/s)", "batch Nt (f/s)", "scaling" );
+	printf( "%8s %16s %13zu t\n", "", "", threads );
+
+	for ( size_t fft_size : k_sizes ) {
+		double single = bench_batch( signal, fft_size, 1 );
+		double multi  = bench_batch( signal, fft_size, threads );
+		printf( "%8zu %16.0f %16.0f %9.2fx\n", fft_size, single, multi, multi / single );
+	}
+
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include "application.h"
 #include "../audio/audio_engine.h"
+#include "../dsp/fft_plan_cache.h"
 #include "../gui/layout_manager.h"
 
 // meters
@@ -19,6 +20,7 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <cstdio>
 
 namespace pm
@@ -47,6 +49,12 @@ namespace pm
 			// continue
 		}
 
+		// build shared plans/windows before any meter needs them, on kissfft so
+		// startup never waits on a benchmark. the fastest library per size is
+		// timed in the background and meters move to it on their next frame
+		fft_plan_cache::instance( ).prewarm( );
+		backend_probe_ = std::jthread( []( std::stop_token stop ) { fft_plan_cache::instance( ).select_fastest_backends( stop ); } );
+
 		// initialize layout manager with all meters
 		layout_manager_ = std::make_unique< layout_manager >( );
 		layout_manager_->add_meter( std::make_shared< oscilloscope >( ) );
@@ -168,9 +176,16 @@ namespace pm
 		// get audio samples and update meters
 		if ( audio_engine_ && audio_engine_->is_capturing( ) ) {
 			static std::vector< sample_t > samples( 4096 );
-			size_t count = audio_engine_->get_capture( ).get_samples( samples.data( ), samples.size( ) );
+
+			// the ring holds whole interleaved frames of the device's layout,
+			// pop a whole number of them so frames never straddle two reads
+			const int channels  = std::max( audio_engine_->get_capture( ).get_channels( ), 1 );
+			const size_t frames = samples.size( ) / static_cast< size_t >( channels );
+			size_t count        = audio_engine_->get_capture( ).get_samples( samples.data( ), frames * channels );
 			if ( count > 0 && layout_manager_ ) {
-				layout_manager_->update_all( samples.data( ), count / 2, 2 ); // stereo
+				layout_manager_->set_sample_rate( audio_engine_->get_capture( ).get_sample_rate( ) );
+				layout_manager_->update_all( samples.data( ), count / channels, channels );
+				audio_engine_->update_peak_levels( layout_manager_->get_levels( ) );
 			}
 		}
 
@@ -267,6 +282,12 @@ namespace pm
 
 	void application::shutdown( )
 	{
+		// stops between measurements, so exit waits for one at most
+		if ( backend_probe_.joinable( ) ) {
+			backend_probe_.request_stop( );
+			backend_probe_.join( );
+		}
+
 		layout_manager_.reset( );
 
 		if ( audio_engine_ ) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <thread>
 
 struct GLFWwindow;
 
@@ -34,6 +35,9 @@ namespace pm
 		std::unique_ptr< audio_engine > audio_engine_;
 		std::unique_ptr< class layout_manager > layout_manager_;
 
+		// times the FFT backends after startup, see fft_plan_cache
+		std::jthread backend_probe_;
+
 		// GUI state
 		GLFWwindow* window_ = nullptr;
 
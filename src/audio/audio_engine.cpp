@@ -30,27 +30,6 @@ namespace pm
 			return false;
 		}
 
-		// set up audio callback for level tracking
-		capture_.set_callback( [ this ]( const sample_t* samples, size_t frame_count, int channels ) {
-			float max_left  = 0.0f;
-			float max_right = 0.0f;
-
-			for ( size_t i = 0; i < frame_count; ++i ) {
-				if ( channels >= 1 ) {
-					float l  = std::abs( samples[ i * channels ] );
-					max_left = std::max( max_left, l );
-				}
-				if ( channels >= 2 ) {
-					float r   = std::abs( samples[ i * channels + 1 ] );
-					max_right = std::max( max_right, r );
-				}
-			}
-
-			// simple peak hold with decay
-			peak_left_  = std::max( peak_left_ * 0.95f, max_left );
-			peak_right_ = std::max( peak_right_ * 0.95f, max_right );
-		} );
-
 		initialized_ = true;
 
 		// auto-start capturing system output (loopback)
@@ -79,6 +58,16 @@ namespace pm
 		capture_.stop( );
 	}
 
+	void audio_engine::update_peak_levels( const level_stats& levels )
+	{
+		float max_left  = ( levels.channels >= 1 ) ? levels.get_peak( 0 ) : 0.0f;
+		float max_right = ( levels.channels >= 2 ) ? levels.get_peak( 1 ) : 0.0f;
+
+		// simple peak hold with decay
+		peak_left_  = std::max( peak_left_ * 0.95f, max_left );
+		peak_right_ = std::max( peak_right_ * 0.95f, max_right );
+	}
+
 	void audio_engine::get_peak_levels( float& left, float& right )
 	{
 		left  = peak_left_;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common/types.h"
+#include "../dsp/level_stats.h"
 #include "audio_capture.h"
 #include "device_enumerator.h"
 #include <memory>
@@ -45,6 +46,10 @@ namespace pm
 			return capture_;
 		}
 
+		// peak hold from the block statistics the meters already computed, so
+		// the audio is not scanned a second time
+		void update_peak_levels( const level_stats& levels );
+
 		// get current audio levels (peak)
 		void get_peak_levels( float& left, float& right );
 
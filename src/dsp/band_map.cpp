@@ -0,0 +1,90 @@
+#include "band_map.h"
+#include "spectral_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	static constexpr float k_db_per_log2_power = 3.01029996f; // 10 * log10( 2 )
+	static constexpr float k_power_floor       = 1e-20f;
+
+	void band_map::build( const float* band_start, const float* band_end, size_t band_count, size_t fft_size, int sample_rate )
+	{
+		fft_size_    = fft_size;
+		sample_rate_ = sample_rate;
+
+		band_offsets_.assign( 1, 0 );
+		bin_indices_.clear( );
+		weights_.clear( );
+
+		const size_t bin_count = fft_size / 2;
+		const float bin_width  = static_cast< float >( sample_rate ) / static_cast< float >( fft_size );
+		const float last_bin   = static_cast< float >( bin_count - 1 );
+
+		for ( size_t band = 0; band < band_count; ++band ) {
+			// in bin units, bin k is centred on k and covers [k - 0.5, k + 0.5)
+			float lo = band_start[ band ] / bin_width;
+			float hi = band_end[ band ] / bin_width;
+
+			if ( hi - lo < 1.0f ) {
+				float center = std::clamp( ( lo + hi ) * 0.5f, 0.0f, last_bin );
+				auto below   = static_cast< uint32_t >( center );
+				auto above   = std::min( below + 1, static_cast< uint32_t >( bin_count - 1 ) );
+				float frac   = center - static_cast< float >( below );
+
+				bin_indices_.push_back( below );
+				weights_.push_back( 1.0f - frac );
+				if ( above != below ) {
+					bin_indices_.push_back( above );
+					weights_.push_back( frac );
+				}
+			} else {
+				size_t first = static_cast< size_t >( std::max( 0.0f, std::floor( lo + 0.5f ) ) );
+				size_t last  = std::min( static_cast< size_t >( std::max( 0.0f, std::ceil( hi + 0.5f ) ) ), bin_count );
+				size_t begin = weights_.size( );
+				float total  = 0.0f;
+
+				for ( size_t k = first; k < last; ++k ) {
+					float bin   = static_cast< float >( k );
+					float cover = std::min( hi, bin + 0.5f ) - std::max( lo, bin - 0.5f );
+					if ( cover <= 0.0f )
+						continue;
+
+					bin_indices_.push_back( static_cast< uint32_t >( k ) );
+					weights_.push_back( cover );
+					total += cover;
+				}
+
+				if ( total > 0.0f ) {
+					for ( size_t j = begin; j < weights_.size( ); ++j ) {
+						weights_[ j ] /= total;
+					}
+				} else {
+					// band entirely above nyquist, read the last bin
+					bin_indices_.push_back( static_cast< uint32_t >( bin_count - 1 ) );
+					weights_.push_back( 1.0f );
+				}
+			}
+
+			band_offsets_.push_back( static_cast< uint32_t >( weights_.size( ) ) );
+		}
+
+		products_.resize( weights_.size( ) );
+	}
+
+	void band_map::reduce_db( const float* magnitudes, float min_db, float* band_db )
+	{
+		gather_power( magnitudes, bin_indices_.data( ), weights_.data( ), weights_.size( ), products_.data( ) );
+
+		const size_t band_count = get_band_count( );
+		for ( size_t band = 0; band < band_count; ++band ) {
+			float power = 0.0f;
+			for ( uint32_t j = band_offsets_[ band ]; j < band_offsets_[ band + 1 ]; ++j ) {
+				power += products_[ j ];
+			}
+			band_db[ band ] = std::max( k_db_per_log2_power * fast_log2( std::max( power, k_power_floor ) ), min_db );
+		}
+	}
+
+} // namespace pm
@@ -0,0 +1,51 @@
+#pragma once
+
+// precomputed FFT bin to display band reduction tables
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pm
+{
+
+	// sparse weights mapping the N/2 magnitude bins of one FFT configuration
+	// onto a fixed set of display bands. built once per (fft size, sample rate,
+	// band layout), after which reduce_db( ) is one gather pass plus a short
+	// per-band sum, with no pow / log10 / bin search per band per frame.
+	//
+	// bands at least one bin wide average the power of every bin they overlap,
+	// weighted by the overlap. narrower bands (the low end of a log axis)
+	// linearly interpolate the power of the two bins around their centre, so
+	// neighbouring bands no longer repeat the same bin as a staircase
+	class band_map
+	{
+	public:
+		// band i covers [band_start[ i ], band_end[ i ]) Hz
+		void build( const float* band_start, const float* band_end, size_t band_count, size_t fft_size, int sample_rate );
+
+		bool is_built_for( size_t fft_size, int sample_rate ) const
+		{
+			return fft_size_ == fft_size && sample_rate_ == sample_rate;
+		}
+
+		// magnitudes: N/2 linear bin magnitudes, band_db: get_band_count( ) values
+		void reduce_db( const float* magnitudes, float min_db, float* band_db );
+
+		size_t get_band_count( ) const
+		{
+			return band_offsets_.empty( ) ? 0 : band_offsets_.size( ) - 1;
+		}
+
+	private:
+		size_t fft_size_ = 0;
+		int sample_rate_ = 0;
+
+		// entries of band i are [band_offsets_[ i ], band_offsets_[ i + 1 ])
+		std::vector< uint32_t > band_offsets_;
+		std::vector< uint32_t > bin_indices_;
+		std::vector< float > weights_;
+		std::vector< float > products_;
+	};
+
+} // namespace pm
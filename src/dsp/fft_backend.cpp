@@ -0,0 +1,368 @@
+#include "fft_backend.h"
+#include "fixed_fft.h"
+#include "kiss_fft.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined( PM_HAVE_POCKETFFT )
+#	include "pocketfft_hdronly.h"
+#endif
+
+#if defined( PM_HAVE_FFTW )
+#	include <fftw3.h>
+#endif
+
+namespace pm
+{
+
+	// ==========================================================================
+	// real transform via an N/2 point complex one
+	// ==========================================================================
+
+	// e^{-i pi ( k / (N/2) + 1/2 )} for k = 1 .. N/4, interleaved re/im
+	static std::vector< float > make_super_twiddles( size_t size )
+	{
+		const size_t half = size / 2;
+
+		std::vector< float > twiddles( half );
+		for ( size_t i = 0; i < half / 2; ++i ) {
+			double phase          = -3.14159265358979323846 * ( static_cast< double >( i + 1 ) / static_cast< double >( half ) + 0.5 );
+			twiddles[ i * 2 ]     = static_cast< float >( std::cos( phase ) );
+			twiddles[ i * 2 + 1 ] = static_cast< float >( std::sin( phase ) );
+		}
+		return twiddles;
+	}
+
+	// `packed` is the N/2 point transform of the even / odd samples packed as
+	// re / im, split here into the N/2 + 1 bins of the real transform
+	static void split_real_spectrum( const float* packed, float* output, size_t size, const float* super_twiddles )
+	{
+		const size_t half = size / 2;
+
+		output[ 0 ]            = packed[ 0 ] + packed[ 1 ];
+		output[ 1 ]            = 0.0f;
+		output[ half * 2 ]     = packed[ 0 ] - packed[ 1 ];
+		output[ half * 2 + 1 ] = 0.0f;
+
+		for ( size_t k = 1; k <= half / 2; ++k ) {
+			const float fpk_r  = packed[ k * 2 ];
+			const float fpk_i  = packed[ k * 2 + 1 ];
+			const float fpnk_r = packed[ ( half - k ) * 2 ];
+			const float fpnk_i = -packed[ ( half - k ) * 2 + 1 ];
+
+			const float f1k_r = fpk_r + fpnk_r, f1k_i = fpk_i + fpnk_i;
+			const float f2k_r = fpk_r - fpnk_r, f2k_i = fpk_i - fpnk_i;
+
+			const float w_r  = super_twiddles[ ( k - 1 ) * 2 ];
+			const float w_i  = super_twiddles[ ( k - 1 ) * 2 + 1 ];
+			const float tw_r = f2k_r * w_r - f2k_i * w_i;
+			const float tw_i = f2k_r * w_i + f2k_i * w_r;
+
+			output[ k * 2 ]                = ( f1k_r + tw_r ) * 0.5f;
+			output[ k * 2 + 1 ]            = ( f1k_i + tw_i ) * 0.5f;
+			output[ ( half - k ) * 2 ]     = ( f1k_r - tw_r ) * 0.5f;
+			output[ ( half - k ) * 2 + 1 ] = ( tw_i - f1k_i ) * 0.5f;
+		}
+	}
+
+	// ==========================================================================
+	// kissfft
+	// ==========================================================================
+
+	// kiss_fft_cfg is read-only during an out-of-place kiss_fft, which is what
+	// makes sharing safe. kiss_fftr keeps scratch inside its cfg, so the real
+	// transform is split by hand instead, with the scratch supplied by the caller
+	class kissfft_backend : public fft_backend
+	{
+	public:
+		explicit kissfft_backend( size_t size ) : size_( size )
+		{
+			const size_t half = size / 2;
+
+			half_cfg_       = kiss_fft_alloc( static_cast< int >( half ), 0, nullptr, nullptr );
+			full_cfg_       = kiss_fft_alloc( static_cast< int >( size ), 0, nullptr, nullptr );
+			super_twiddles_ = make_super_twiddles( size );
+		}
+
+		~kissfft_backend( ) override
+		{
+			kiss_fft_free( half_cfg_ );
+			kiss_fft_free( full_cfg_ );
+		}
+
+		void forward_real( const float* input, float* output, float* scratch ) const override
+		{
+			// even samples in the real part, odd samples in the imaginary part
+			kiss_fft( half_cfg_, reinterpret_cast< const kiss_fft_cpx* >( input ), reinterpret_cast< kiss_fft_cpx* >( scratch ) );
+			split_real_spectrum( scratch, output, size_, super_twiddles_.data( ) );
+		}
+
+		void forward_complex( const float* input, float* output ) const override
+		{
+			kiss_fft( full_cfg_, reinterpret_cast< const kiss_fft_cpx* >( input ), reinterpret_cast< kiss_fft_cpx* >( output ) );
+		}
+
+	private:
+		size_t size_;
+		kiss_fft_cfg half_cfg_ = nullptr; // N/2 point, real path
+		kiss_fft_cfg full_cfg_ = nullptr; // N point, complex path
+		std::vector< float > super_twiddles_;
+	};
+
+	// ==========================================================================
+	// pocketfft
+	// ==========================================================================
+
+#if defined( PM_HAVE_POCKETFFT )
+
+	// the plan objects' exec( ) is const and works in place. note that pocketfft
+	// allocates a work array per call, which the benchmark accounts for
+	class pocketfft_backend : public fft_backend
+	{
+	public:
+		explicit pocketfft_backend( size_t size ) : size_( size ), real_plan_( size ), complex_plan_( size ) { }
+
+		void forward_real( const float* input, float* output, float* scratch ) const override
+		{
+			std::memcpy( scratch, input, size_ * sizeof( float ) );
+			real_plan_.exec( scratch, 1.0f, true );
+
+			// halfcomplex order: r0, r1, i1, r2, i2, ..., r(N/2)
+			const size_t half = size_ / 2;
+
+			output[ 0 ] = scratch[ 0 ];
+			output[ 1 ] = 0.0f;
+			for ( size_t k = 1; k < half; ++k ) {
+				output[ k * 2 ]     = scratch[ k * 2 - 1 ];
+				output[ k * 2 + 1 ] = scratch[ k * 2 ];
+			}
+			output[ half * 2 ]     = scratch[ size_ - 1 ];
+			output[ half * 2 + 1 ] = 0.0f;
+		}
+
+		void forward_complex( const float* input, float* output ) const override
+		{
+			std::memcpy( output, input, size_ * 2 * sizeof( float ) );
+			complex_plan_.exec( reinterpret_cast< pocketfft::detail::cmplx< float >* >( output ), 1.0f, true );
+		}
+
+	private:
+		size_t size_;
+		pocketfft::detail::pocketfft_r< float > real_plan_;
+		pocketfft::detail::pocketfft_c< float > complex_plan_;
+	};
+
+#endif
+
+	// ==========================================================================
+	// fftw
+	// ==========================================================================
+
+#if defined( PM_HAVE_FFTW )
+
+	// planned unaligned so the new-array execute functions accept any buffer.
+	// those are the documented thread-safe entry points, planning is not
+	class fftw_backend : public fft_backend
+	{
+	public:
+		explicit fftw_backend( size_t size )
+		{
+			const int n              = static_cast< int >( size );
+			const unsigned int flags = FFTW_MEASURE | FFTW_UNALIGNED;
+
+			// FFTW_MEASURE overwrites the arrays while planning
+			float* in           = fftwf_alloc_real( size * 2 );
+			fftwf_complex* out  = fftwf_alloc_complex( size );
+			fftwf_complex* c_in = reinterpret_cast< fftwf_complex* >( in );
+
+			real_plan_    = fftwf_plan_dft_r2c_1d( n, in, out, flags );
+			complex_plan_ = fftwf_plan_dft_1d( n, c_in, out, FFTW_FORWARD, flags );
+
+			fftwf_free( in );
+			fftwf_free( out );
+		}
+
+		~fftw_backend( ) override
+		{
+			fftwf_destroy_plan( real_plan_ );
+			fftwf_destroy_plan( complex_plan_ );
+		}
+
+		void forward_real( const float* input, float* output, float* ) const override
+		{
+			// out-of-place 1D r2c leaves the input untouched
+			fftwf_execute_dft_r2c( real_plan_, const_cast< float* >( input ), reinterpret_cast< fftwf_complex* >( output ) );
+		}
+
+		void forward_complex( const float* input, float* output ) const override
+		{
+			fftwf_execute_dft( complex_plan_, reinterpret_cast< fftwf_complex* >( const_cast< float* >( input ) ),
+			                   reinterpret_cast< fftwf_complex* >( output ) );
+		}
+
+	private:
+		fftwf_plan real_plan_    = nullptr;
+		fftwf_plan complex_plan_ = nullptr;
+	};
+
+#endif
+
+	// ==========================================================================
+	// fixed-size kernels
+	// ==========================================================================
+
+	// fixed_fft<N> instantiations for the sizes the analysers use. the real
+	// path runs the N/2 kernel, so a size is supported when both exist
+	class fixed_backend : public fft_backend
+	{
+	public:
+		using kernel_fn = void ( * )( const float*, float* );
+
+		fixed_backend( size_t size, kernel_fn half_kernel, kernel_fn full_kernel )
+		    : size_( size ), half_kernel_( half_kernel ), full_kernel_( full_kernel ), super_twiddles_( make_super_twiddles( size ) )
+		{
+		}
+
+		void forward_real( const float* input, float* output, float* scratch ) const override
+		{
+			half_kernel_( input, scratch );
+			split_real_spectrum( scratch, output, size_, super_twiddles_.data( ) );
+		}
+
+		void forward_complex( const float* input, float* output ) const override
+		{
+			full_kernel_( input, output );
+		}
+
+	private:
+		size_t size_;
+		kernel_fn half_kernel_;
+		kernel_fn full_kernel_;
+		std::vector< float > super_twiddles_;
+	};
+
+	template< size_t N >
+	static std::unique_ptr< fft_backend > create_fixed_backend( )
+	{
+		return std::make_unique< fixed_backend >( N, &fixed_fft< N / 2 >::forward, &fixed_fft< N >::forward );
+	}
+
+	static std::unique_ptr< fft_backend > create_fixed_backend( size_t size )
+	{
+		switch ( size ) {
+		case 1024:
+			return create_fixed_backend< 1024 >( );
+		case 2048:
+			return create_fixed_backend< 2048 >( );
+		case 4096:
+			return create_fixed_backend< 4096 >( );
+		case 8192:
+			return create_fixed_backend< 8192 >( );
+		case 16384:
+			return create_fixed_backend< 16384 >( );
+		default:
+			return nullptr;
+		}
+	}
+
+	// ==========================================================================
+	// selection
+	// ==========================================================================
+
+	const char* get_fft_backend_name( fft_backend_type type )
+	{
+		switch ( type ) {
+		case fft_backend_type::kissfft:
+			return "kissfft";
+		case fft_backend_type::pocketfft:
+			return "pocketfft";
+		case fft_backend_type::fftw:
+			return "fftw";
+		case fft_backend_type::fixed:
+			return "fixed";
+		}
+		return "unknown";
+	}
+
+	bool is_fft_backend_available( fft_backend_type type )
+	{
+		switch ( type ) {
+		case fft_backend_type::kissfft:
+			return true;
+		case fft_backend_type::pocketfft:
+#if defined( PM_HAVE_POCKETFFT )
+			return true;
+#else
+			return false;
+#endif
+		case fft_backend_type::fftw:
+#if defined( PM_HAVE_FFTW )
+			return true;
+#else
+			return false;
+#endif
+		case fft_backend_type::fixed:
+			return true;
+		}
+		return false;
+	}
+
+	std::unique_ptr< fft_backend > create_fft_backend( fft_backend_type type, size_t size )
+	{
+		switch ( type ) {
+		case fft_backend_type::kissfft:
+			return std::make_unique< kissfft_backend >( size );
+#if defined( PM_HAVE_POCKETFFT )
+		case fft_backend_type::pocketfft:
+			return std::make_unique< pocketfft_backend >( size );
+#endif
+#if defined( PM_HAVE_FFTW )
+		case fft_backend_type::fftw:
+			return std::make_unique< fftw_backend >( size );
+#endif
+		case fft_backend_type::fixed:
+			return create_fixed_backend( size );
+		default:
+			return nullptr;
+		}
+	}
+
+	double measure_fft_backend( fft_backend_type type, size_t size, size_t iterations )
+	{
+		auto backend = create_fft_backend( type, size );
+		if ( !backend )
+			return -1.0;
+
+		return measure_fft_backend( *backend, size, iterations );
+	}
+
+	double measure_fft_backend( const fft_backend& backend, size_t size, size_t iterations )
+	{
+		if ( iterations == 0 )
+			return -1.0;
+
+		std::vector< float > input( size * 2 );
+		std::vector< float > output( size * 2 + 2 );
+		std::vector< float > scratch( size );
+
+		for ( size_t i = 0; i < input.size( ); ++i ) {
+			input[ i ] = std::sin( static_cast< float >( i ) * 0.01f );
+		}
+
+		// one untimed pass to fault in tables and buffers
+		backend.forward_real( input.data( ), output.data( ), scratch.data( ) );
+		backend.forward_complex( input.data( ), output.data( ) );
+
+		auto start = std::chrono::steady_clock::now( );
+		for ( size_t i = 0; i < iterations; ++i ) {
+			backend.forward_real( input.data( ), output.data( ), scratch.data( ) );
+			backend.forward_complex( input.data( ), output.data( ) );
+		}
+		auto elapsed = std::chrono::steady_clock::now( ) - start;
+
+		return std::chrono::duration< double, std::nano >( elapsed ).count( ) / static_cast< double >( iterations );
+	}
+
+} // namespace pm
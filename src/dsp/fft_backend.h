@@ -0,0 +1,52 @@
+#pragma once
+
+// FFT library abstraction, one implementation per supported library
+
+#include <cstddef>
+#include <memory>
+
+namespace pm
+{
+
+	enum class fft_backend_type {
+		kissfft,   // always built, the reference
+		pocketfft, // header-only, PM_FFT_POCKETFFT
+		fftw,      // single precision FFTW when found at configure time
+		fixed      // fixed_fft kernels, power-of-two sizes 1024 .. 16384 only
+	};
+
+	constexpr size_t k_fft_backend_count = 4;
+
+	// one transform size on one library. implementations are immutable after
+	// construction and safe to execute from several threads at once. complex
+	// data is interleaved re/im floats, output is unnormalised
+	class fft_backend
+	{
+	public:
+		virtual ~fft_backend( ) = default;
+
+		// N real samples -> N/2 + 1 complex bins. scratch must hold N floats
+		virtual void forward_real( const float* input, float* output, float* scratch ) const = 0;
+
+		// N complex samples -> N complex bins (input and output must not alias)
+		virtual void forward_complex( const float* input, float* output ) const = 0;
+	};
+
+	const char* get_fft_backend_name( fft_backend_type type );
+
+	// false when the library was not compiled in
+	bool is_fft_backend_available( fft_backend_type type );
+
+	// nullptr when the backend is unavailable or has no kernel for `size`. not thread-safe (FFTW planning
+	// is global), callers serialise creation
+	std::unique_ptr< fft_backend > create_fft_backend( fft_backend_type type, size_t size );
+
+	// average nanoseconds for one real plus one complex transform of `size`
+	// points, or a negative value when the backend is unavailable
+	double measure_fft_backend( fft_backend_type type, size_t size, size_t iterations );
+
+	// same timing on a backend that already exists, so it needs no creation
+	// lock around it
+	double measure_fft_backend( const fft_backend& backend, size_t size, size_t iterations );
+
+} // namespace pm
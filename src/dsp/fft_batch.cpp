@@ -0,0 +1,204 @@
+#include "fft_batch.h"
+#include "spectral_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace pm
+{
+
+	// frames claimed per grab, keeps the shared counter off the hot path
+	static constexpr size_t k_frames_per_claim = 4;
+
+	// below this many frames per thread waking the workers costs more than it saves
+	static constexpr size_t k_min_frames_per_thread = 8;
+
+	struct fft_batch::scratch {
+		std::vector< float > input;
+		std::vector< float > fft_scratch;
+		std::vector< float > output;
+		std::vector< float > magnitudes_db;
+
+		void resize( size_t fft_size )
+		{
+			input.resize( fft_size );
+			fft_scratch.resize( fft_size );
+			output.resize( fft_size + 2 );
+			magnitudes_db.resize( fft_size / 2 );
+		}
+	};
+
+	// persistent workers, woken once per process( ) call. worker 0 is the caller
+	struct fft_batch::worker_pool {
+		std::vector< std::thread > threads;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+
+		std::function< void( size_t ) > job;
+		size_t generation = 0;
+		size_t running    = 0;
+		bool stop         = false;
+
+		explicit worker_pool( size_t worker_count )
+		{
+			for ( size_t i = 1; i < worker_count; ++i ) {
+				threads.emplace_back( [ this, i ] { run( i ); } );
+			}
+		}
+
+		~worker_pool( )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				stop = true;
+			}
+			wake.notify_all( );
+			for ( auto& thread : threads ) {
+				thread.join( );
+			}
+		}
+
+		void run( size_t index )
+		{
+			size_t seen = 0;
+			for ( ;; ) {
+				std::unique_lock< std::mutex > lock( mutex );
+				wake.wait( lock, [ & ] { return stop || generation != seen; } );
+				if ( stop )
+					return;
+				seen = generation;
+				lock.unlock( );
+
+				job( index );
+
+				lock.lock( );
+				if ( --running == 0 ) {
+					done.notify_one( );
+				}
+			}
+		}
+
+		// runs job( 0 ) on the caller and job( 1.. ) on the workers, then waits
+		void execute( std::function< void( size_t ) > work )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				job     = std::move( work );
+				running = threads.size( );
+				generation++;
+			}
+			wake.notify_all( );
+
+			job( 0 );
+
+			std::unique_lock< std::mutex > lock( mutex );
+			done.wait( lock, [ & ] { return running == 0; } );
+		}
+	};
+
+	fft_batch::fft_batch( size_t fft_size, size_t thread_count ) : fft_size_( fft_size )
+	{
+		if ( thread_count == 0 ) {
+			thread_count = std::max< size_t >( std::thread::hardware_concurrency( ), 1 );
+		}
+
+		for ( size_t i = 0; i < thread_count; ++i ) {
+			scratch_.push_back( std::make_unique< scratch >( ) );
+		}
+		if ( thread_count > 1 ) {
+			pool_ = std::make_unique< worker_pool >( thread_count );
+		}
+
+		set_fft_size( fft_size );
+	}
+
+	fft_batch::~fft_batch( ) = default;
+
+	size_t fft_batch::get_thread_count( ) const
+	{
+		return scratch_.size( );
+	}
+
+	void fft_batch::set_fft_size( size_t size )
+	{
+		auto& cache = fft_plan_cache::instance( );
+
+		fft_size_        = size;
+		plan_generation_ = cache.get_generation( );
+		plan_            = cache.get_plan( size );
+		window_          = cache.get_window( size, window_type_ );
+
+		for ( auto& buffers : scratch_ ) {
+			buffers->resize( size );
+		}
+	}
+
+	void fft_batch::set_window_type( fft_window_type type )
+	{
+		window_type_ = type;
+		window_      = fft_plan_cache::instance( ).get_window( fft_size_, type );
+	}
+
+	void fft_batch::process_frame( scratch& buffers, const sample_t* input, float* magnitudes, float* magnitudes_db ) const
+	{
+		const float* window = window_->data( );
+		float* in           = buffers.input.data( );
+
+		for ( size_t i = 0; i < fft_size_; ++i ) {
+			in[ i ] = input[ i ] * window[ i ];
+		}
+
+		plan_->forward_real( in, buffers.output.data( ), buffers.fft_scratch.data( ) );
+
+		// the kernel blends with the previous contents, smoothing 0 still reads them
+		const size_t bins = fft_size_ / 2;
+		std::fill( magnitudes, magnitudes + bins, 0.0f );
+		magnitude_db( buffers.output.data( ), bins, 2.0f / static_cast< float >( fft_size_ ), 0.0f, -100.0f, magnitudes,
+		              magnitudes_db ? magnitudes_db : buffers.magnitudes_db.data( ) );
+	}
+
+	void fft_batch::process( const sample_t* input, size_t hop, size_t frames, float* magnitudes, float* magnitudes_db )
+	{
+		if ( frames == 0 )
+			return;
+
+		// pick up a backend switch before the workers share plan_
+		auto& cache = fft_plan_cache::instance( );
+		if ( cache.get_generation( ) != plan_generation_ ) {
+			plan_generation_ = cache.get_generation( );
+			plan_            = cache.get_plan( fft_size_ );
+		}
+
+		const size_t bins = get_bin_count( );
+
+		auto frame = [ & ]( size_t worker, size_t index ) {
+			process_frame( *scratch_[ worker ], input + index * hop, magnitudes + index * bins, magnitudes_db ? magnitudes_db + index * bins : nullptr );
+		};
+
+		if ( !pool_ || frames < k_min_frames_per_thread * get_thread_count( ) ) {
+			for ( size_t i = 0; i < frames; ++i ) {
+				frame( 0, i );
+			}
+			return;
+		}
+
+		std::atomic< size_t > next{ 0 };
+		pool_->execute( [ & ]( size_t worker ) {
+			for ( ;; ) {
+				size_t first = next.fetch_add( k_frames_per_claim, std::memory_order_relaxed );
+				if ( first >= frames )
+					return;
+
+				size_t last = std::min( first + k_frames_per_claim, frames );
+				for ( size_t i = first; i < last; ++i ) {
+					frame( worker, i );
+				}
+			}
+		} );
+	}
+
+} // namespace pm
@@ -0,0 +1,65 @@
+#pragma once
+
+// batched multi-frame FFT for backlog and offline analysis
+
+#include "../common/types.h"
+#include "fft_plan_cache.h"
+#include <memory>
+#include <vector>
+
+namespace pm
+{
+
+	// transforms K hops of a mono signal in one call. each frame is windowed,
+	// transformed and reduced to magnitudes back to back in per-thread
+	// buffers, so a frame's working set stays in cache across the three
+	// passes instead of streaming whole buffers through each pass in turn.
+	// frames are split across worker threads, the calling thread included.
+	// results are raw per-frame magnitudes (no smoothing, which is inherently
+	// sequential; feed them through a spectral_averager if needed)
+	class fft_batch
+	{
+	public:
+		// thread_count 0 = one per hardware thread, 1 = no workers
+		explicit fft_batch( size_t fft_size = k_fft_size_4096, size_t thread_count = 0 );
+		~fft_batch( );
+
+		fft_batch( const fft_batch& )            = delete;
+		fft_batch& operator=( const fft_batch& ) = delete;
+
+		void set_fft_size( size_t size );
+		size_t get_fft_size( ) const
+		{
+			return fft_size_;
+		}
+		size_t get_bin_count( ) const
+		{
+			return fft_size_ / 2;
+		}
+		void set_window_type( fft_window_type type );
+
+		size_t get_thread_count( ) const;
+
+		// frame i covers input[ i * hop, i * hop + fft_size ), so input must hold
+		// ( frames - 1 ) * hop + fft_size samples. magnitudes and (optional)
+		// magnitudes_db receive frames * get_bin_count( ) values, frame-major
+		void process( const sample_t* input, size_t hop, size_t frames, float* magnitudes, float* magnitudes_db = nullptr );
+
+	private:
+		struct worker_pool;
+		struct scratch;
+
+		size_t fft_size_;
+		fft_window_type window_type_ = fft_window_type::hann;
+
+		std::shared_ptr< const fft_plan > plan_;
+		uint32_t plan_generation_ = 0; // fft_plan_cache generation plan_ came from
+		std::shared_ptr< const fft_window_table > window_;
+
+		std::vector< std::unique_ptr< scratch > > scratch_; // one per thread
+		std::unique_ptr< worker_pool > pool_;
+
+		void process_frame( scratch& buffers, const sample_t* input, float* magnitudes, float* magnitudes_db ) const;
+	};
+
+} // namespace pm
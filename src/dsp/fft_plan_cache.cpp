@@ -0,0 +1,214 @@
+#include "fft_plan_cache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// FFTW planning and plan destruction touch global state, so every backend
+	// is created and destroyed under this lock, including the candidates built
+	// while measuring. held only for that, and never together with
+	// fft_plan_cache::mutex_
+	static std::mutex& backend_creation_mutex( )
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	fft_plan::fft_plan( size_t size, fft_backend_type backend ) : backend_type_( backend ), size_( size )
+	{
+		std::lock_guard< std::mutex > lock( backend_creation_mutex( ) );
+
+		backend_ = create_fft_backend( backend, size );
+		if ( !backend_ ) {
+			backend_type_ = fft_backend_type::kissfft;
+			backend_      = create_fft_backend( backend_type_, size );
+		}
+	}
+
+	fft_plan::~fft_plan( )
+	{
+		std::lock_guard< std::mutex > lock( backend_creation_mutex( ) );
+		backend_.reset( );
+	}
+
+	static fft_window_table build_window( size_t size, fft_window_type type )
+	{
+		fft_window_table window( size );
+
+		const double pi = 3.14159265358979323846;
+		const double n  = static_cast< double >( size );
+
+		for ( size_t i = 0; i < size; ++i ) {
+			double x = static_cast< double >( i ) / ( n - 1.0 );
+
+			switch ( type ) {
+			case fft_window_type::none:
+				window[ i ] = 1.0f;
+				break;
+			case fft_window_type::hann:
+				window[ i ] = static_cast< float >( 0.5 * ( 1.0 - std::cos( 2.0 * pi * x ) ) );
+				break;
+			case fft_window_type::hamming:
+				window[ i ] = static_cast< float >( 0.54 - 0.46 * std::cos( 2.0 * pi * x ) );
+				break;
+			case fft_window_type::blackman:
+				window[ i ] = static_cast< float >( 0.42 - 0.5 * std::cos( 2.0 * pi * x ) + 0.08 * std::cos( 4.0 * pi * x ) );
+				break;
+			}
+		}
+
+		return window;
+	}
+
+	fft_plan_cache& fft_plan_cache::instance( )
+	{
+		static fft_plan_cache cache;
+		return cache;
+	}
+
+	std::shared_ptr< const fft_plan > fft_plan_cache::get_plan( size_t size )
+	{
+		for ( ;; ) {
+			fft_backend_type type = fft_backend_type::kissfft;
+			uint32_t generation   = 0;
+			{
+				std::lock_guard< std::mutex > lock( mutex_ );
+
+				auto cached = plans_.find( size );
+				if ( cached != plans_.end( ) )
+					return cached->second;
+
+				auto backend = backends_.find( size );
+				if ( backend != backends_.end( ) ) {
+					type = backend->second;
+				}
+				generation = generation_.load( std::memory_order_relaxed );
+			}
+
+			// built outside mutex_ so lookups of cached sizes never wait behind
+			// a backend being planned
+			auto plan = std::make_shared< const fft_plan >( size, type );
+
+			std::lock_guard< std::mutex > lock( mutex_ );
+
+			// another thread may have cached one meanwhile, keep theirs
+			auto cached = plans_.find( size );
+			if ( cached != plans_.end( ) )
+				return cached->second;
+
+			if ( generation_.load( std::memory_order_relaxed ) == generation ) {
+				plans_.emplace( size, plan );
+				return plan;
+			}
+
+			// the backend choice changed while planning, build the new one
+		}
+	}
+
+	std::shared_ptr< const fft_window_table > fft_plan_cache::get_window( size_t size, fft_window_type type )
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		auto& window = windows_[ { size, type } ];
+		if ( !window ) {
+			window = std::make_shared< const fft_window_table >( build_window( size, type ) );
+		}
+		return window;
+	}
+
+	static constexpr size_t k_cached_sizes[] = { k_fft_size_1024, k_fft_size_2048, k_fft_size_4096, k_fft_size_8192, k_fft_size_16384 };
+
+	void fft_plan_cache::prewarm( )
+	{
+		const fft_window_type windows[] = { fft_window_type::none, fft_window_type::hann, fft_window_type::hamming, fft_window_type::blackman };
+
+		for ( size_t size : k_cached_sizes ) {
+			get_plan( size );
+			for ( fft_window_type type : windows ) {
+				get_window( size, type );
+			}
+		}
+	}
+
+	void fft_plan_cache::set_backend( fft_backend_type type )
+	{
+		// released after mutex_, plan destructors take the creation lock
+		std::map< size_t, std::shared_ptr< const fft_plan > > retired;
+
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		backends_.clear( );
+		for ( size_t size : k_cached_sizes ) {
+			backends_[ size ] = type;
+		}
+		retired.swap( plans_ );
+		generation_.fetch_add( 1, std::memory_order_release );
+	}
+
+	void fft_plan_cache::select_fastest_backends( std::stop_token stop )
+	{
+		size_t available = 0;
+		for ( size_t i = 0; i < k_fft_backend_count; ++i ) {
+			if ( is_fft_backend_available( static_cast< fft_backend_type >( i ) ) ) {
+				available++;
+			}
+		}
+		if ( available < 2 )
+			return;
+
+		std::map< size_t, fft_backend_type > fastest;
+		std::map< size_t, std::shared_ptr< const fft_plan > > plans;
+
+		// about 2^24 points per backend and size. each candidate is a real plan
+		// (FFTW_MEASURE can take a while), so the creation lock is only held
+		// while one is built or destroyed and the timing runs with no lock at
+		// all. the winners are kept, get_plan( ) on the analysis side then only
+		// ever swaps pointers
+		for ( size_t size : k_cached_sizes ) {
+			const size_t iterations = std::max< size_t >( ( size_t( 1 ) << 24 ) / ( size * 3 ), 4 );
+
+			std::shared_ptr< const fft_plan > best;
+			double best_time = -1.0;
+
+			for ( size_t i = 0; i < k_fft_backend_count; ++i ) {
+				const auto type = static_cast< fft_backend_type >( i );
+
+				if ( stop.stop_requested( ) )
+					return;
+				if ( !is_fft_backend_available( type ) )
+					continue;
+
+				auto candidate = std::make_shared< const fft_plan >( size, type );
+				if ( candidate->get_backend_type( ) != type )
+					continue; // no kernel for this size, fell back to kissfft
+
+				const double t = measure_fft_backend( candidate->get_backend( ), size, iterations );
+				if ( t > 0.0 && ( best_time < 0.0 || t < best_time ) ) {
+					best      = std::move( candidate );
+					best_time = t;
+				}
+			}
+
+			if ( best ) {
+				fastest[ size ] = best->get_backend_type( );
+				plans[ size ]   = std::move( best );
+			}
+		}
+
+		// the previous plans are released after mutex_, see set_backend( )
+		std::lock_guard< std::mutex > lock( mutex_ );
+		backends_ = std::move( fastest );
+		plans.swap( plans_ );
+		generation_.fetch_add( 1, std::memory_order_release );
+	}
+
+	fft_backend_type fft_plan_cache::get_backend( size_t size )
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		auto backend = backends_.find( size );
+		return backend != backends_.end( ) ? backend->second : fft_backend_type::kissfft;
+	}
+
+} // namespace pm
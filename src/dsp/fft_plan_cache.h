@@ -0,0 +1,112 @@
+#pragma once
+
+// process-wide cache of immutable FFT plans and window tables
+
+#include "../common/types.h"
+#include "fft_backend.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+namespace pm
+{
+
+	enum class fft_window_type {
+		none,
+		hann,
+		hamming,
+		blackman
+	};
+
+	// immutable after construction, so one plan can be shared by any number of
+	// processors on any thread. complex data is interleaved re/im floats
+	class fft_plan
+	{
+	public:
+		explicit fft_plan( size_t size, fft_backend_type backend = fft_backend_type::kissfft );
+		~fft_plan( );
+
+		fft_plan( const fft_plan& )            = delete;
+		fft_plan& operator=( const fft_plan& ) = delete;
+
+		size_t get_size( ) const
+		{
+			return size_;
+		}
+		fft_backend_type get_backend_type( ) const
+		{
+			return backend_type_;
+		}
+		const fft_backend& get_backend( ) const
+		{
+			return *backend_;
+		}
+
+		// N real samples -> N/2 + 1 complex bins. scratch must hold N floats
+		void forward_real( const float* input, float* output, float* scratch ) const
+		{
+			backend_->forward_real( input, output, scratch );
+		}
+
+		// N complex samples -> N complex bins (input and output must not alias)
+		void forward_complex( const float* input, float* output ) const
+		{
+			backend_->forward_complex( input, output );
+		}
+
+	private:
+		std::unique_ptr< fft_backend > backend_;
+		fft_backend_type backend_type_;
+		size_t size_;
+	};
+
+	using fft_window_table = std::vector< float >;
+
+	class fft_plan_cache
+	{
+	public:
+		static fft_plan_cache& instance( );
+
+		// both return the shared entry, building it on first request
+		std::shared_ptr< const fft_plan > get_plan( size_t size );
+		std::shared_ptr< const fft_window_table > get_window( size_t size, fft_window_type type );
+
+		// build every k_fft_size_* plan and window up front so size/window
+		// switches at runtime never allocate
+		void prewarm( );
+
+		// force one library for every size. plans already handed out keep their
+		// backend until their processor sees get_generation( ) change
+		void set_backend( fft_backend_type type );
+
+		// time every compiled-in backend at each k_fft_size_* and use the
+		// fastest per size, including the fixed_fft kernels. takes seconds, so
+		// it belongs on a background thread: candidates are timed with no lock
+		// held, the winning plans are published in one short swap, and nothing
+		// changes if stop is requested first
+		void select_fastest_backends( std::stop_token stop = { } );
+
+		fft_backend_type get_backend( size_t size );
+
+		// changes whenever the backend choice does, processors compare it once
+		// per frame and fetch a fresh plan when it moves
+		uint32_t get_generation( ) const
+		{
+			return generation_.load( std::memory_order_acquire );
+		}
+
+	private:
+		fft_plan_cache( ) = default;
+
+		std::mutex mutex_;
+		std::atomic< uint32_t > generation_{ 0 };
+		std::map< size_t, fft_backend_type > backends_; // sizes not listed use kissfft
+		std::map< size_t, std::shared_ptr< const fft_plan > > plans_;
+		std::map< std::pair< size_t, fft_window_type >, std::shared_ptr< const fft_window_table > > windows_;
+	};
+
+} // namespace pm
@@ -1,33 +1,44 @@
 // FFT processing implementation using KissFFT
 
 #include "fft_processor.h"
-#include "kiss_fft.h"
+#include "spectral_kernels.h"
 #include <algorithm>
 #include <cmath>
 
 namespace pm
 {
 
+	// per-processor scratch, all interleaved re/im. the plan itself is shared
 	struct fft_processor::impl {
-		kiss_fft_cfg cfg = nullptr;
-		std::vector< kiss_fft_cpx > fft_input;
-		std::vector< kiss_fft_cpx > fft_output;
+		std::vector< float > fft_input;
+		std::vector< float > fft_scratch;
+		std::vector< float > fft_output;
+		std::vector< float > stereo_input;
+		std::vector< float > stereo_output;
+		std::array< std::vector< float >, k_fft_channel_count > channel_bins;
 
-		~impl( )
+		void reserve( size_t fft_size )
 		{
-			if ( cfg ) {
-				kiss_fft_free( cfg );
+			fft_input.reserve( fft_size );
+			fft_scratch.reserve( fft_size );
+			fft_output.reserve( fft_size + 2 );
+			stereo_input.reserve( fft_size * 2 );
+			stereo_output.reserve( fft_size * 2 );
+			for ( auto& bins : channel_bins ) {
+				bins.reserve( fft_size );
 			}
 		}
 
 		void resize( size_t fft_size )
 		{
-			if ( cfg ) {
-				kiss_fft_free( cfg );
-			}
-			cfg = kiss_fft_alloc( static_cast< int >( fft_size ), 0, nullptr, nullptr );
 			fft_input.resize( fft_size );
-			fft_output.resize( fft_size );
+			fft_scratch.resize( fft_size );
+			fft_output.resize( fft_size + 2 );
+			stereo_input.resize( fft_size * 2 );
+			stereo_output.resize( fft_size * 2 );
+			for ( auto& bins : channel_bins ) {
+				bins.resize( fft_size );
+			}
 		}
 	};
 
@@ -38,99 +49,249 @@ namespace pm
 
 	fft_processor::~fft_processor( ) = default;
 
+	void fft_processor::reserve( size_t max_fft_size )
+	{
+		impl_->reserve( max_fft_size );
+		for ( size_t ch = 0; ch < k_fft_channel_count; ++ch ) {
+			magnitudes_[ ch ].reserve( max_fft_size / 2 );
+			magnitudes_db_[ ch ].reserve( max_fft_size / 2 );
+			if ( power_smoothing_ ) {
+				smoothed_power_[ ch ].reserve( max_fft_size / 2 );
+			}
+			if ( cumulative_enabled_ ) {
+				cumulative_power_[ ch ].reserve( max_fft_size / 2 + 1 );
+			}
+		}
+	}
+
 	void fft_processor::set_fft_size( size_t size )
 	{
-		fft_size_ = size;
+		auto& cache = fft_plan_cache::instance( );
+
+		fft_size_        = size;
+		plan_generation_ = cache.get_generation( );
+		plan_            = cache.get_plan( size );
+		window_          = cache.get_window( size, window_type_ );
+
 		impl_->resize( size );
-		magnitudes_.resize( size / 2 );
-		magnitudes_db_.resize( size / 2 );
-		input_buffer_.resize( size );
-		compute_window( );
+		for ( size_t ch = 0; ch < k_fft_channel_count; ++ch ) {
+			magnitudes_[ ch ].assign( size / 2, 0.0f );
+			magnitudes_db_[ ch ].assign( size / 2, -100.0f );
+			if ( power_smoothing_ ) {
+				smoothed_power_[ ch ].assign( size / 2, 0.0f );
+			}
+			if ( cumulative_enabled_ ) {
+				cumulative_power_[ ch ].assign( size / 2 + 1, 0.0 );
+			}
+		}
 	}
 
-	void fft_processor::set_window_type( fft_window_type type )
+	void fft_processor::set_power_smoothing( bool enabled )
 	{
-		window_type_ = type;
-		compute_window( );
+		power_smoothing_ = enabled;
+		for ( auto& power : smoothed_power_ ) {
+			if ( enabled ) {
+				power.assign( fft_size_ / 2, 0.0f );
+			} else {
+				power.clear( );
+				power.shrink_to_fit( );
+			}
+		}
 	}
 
-	void fft_processor::compute_window( )
+	void fft_processor::set_cumulative_power( bool enabled )
 	{
-		window_.resize( fft_size_ );
-
-		const float pi = 3.14159265358979323846f;
-		const float n  = static_cast< float >( fft_size_ );
+		cumulative_enabled_ = enabled;
+		cumulative_stale_.fill( false );
+		for ( auto& cumulative : cumulative_power_ ) {
+			if ( enabled ) {
+				cumulative.assign( fft_size_ / 2 + 1, 0.0 );
+			} else {
+				cumulative.clear( );
+				cumulative.shrink_to_fit( );
+			}
+		}
+	}
 
-		for ( size_t i = 0; i < fft_size_; ++i ) {
-			float x = static_cast< float >( i ) / ( n - 1.0f );
+	void fft_processor::set_window_type( fft_window_type type )
+	{
+		window_type_ = type;
+		window_      = fft_plan_cache::instance( ).get_window( fft_size_, type );
+	}
 
-			switch ( window_type_ ) {
-			case fft_window_type::none:
-				window_[ i ] = 1.0f;
-				break;
-			case fft_window_type::hann:
-				window_[ i ] = 0.5f * ( 1.0f - std::cos( 2.0f * pi * x ) );
-				break;
-			case fft_window_type::hamming:
-				window_[ i ] = 0.54f - 0.46f * std::cos( 2.0f * pi * x );
-				break;
-			case fft_window_type::blackman:
-				window_[ i ] = 0.42f - 0.5f * std::cos( 2.0f * pi * x ) + 0.08f * std::cos( 4.0f * pi * x );
-				break;
-			}
+	void fft_processor::refresh_plan( )
+	{
+		// the backend choice changed (select_fastest_backends( ) finished)
+		auto& cache = fft_plan_cache::instance( );
+		if ( cache.get_generation( ) != plan_generation_ ) {
+			plan_generation_ = cache.get_generation( );
+			plan_            = cache.get_plan( fft_size_ );
 		}
 	}
 
 	void fft_processor::process( const sample_t* input, size_t sample_count )
 	{
+		refresh_plan( );
+
 		// copy input and apply window
-		size_t copy_count = std::min( sample_count, fft_size_ );
+		size_t copy_count   = std::min( sample_count, fft_size_ );
+		const float* window = window_->data( );
 
-		// zero-pad if needed
-		for ( size_t i = 0; i < fft_size_; ++i ) {
-			if ( i < copy_count ) {
-				impl_->fft_input[ i ].r = input[ i ] * window_[ i ];
-			} else {
-				impl_->fft_input[ i ].r = 0.0f;
-			}
-			impl_->fft_input[ i ].i = 0.0f;
+		for ( size_t i = 0; i < copy_count; ++i ) {
+			impl_->fft_input[ i ] = input[ i ] * window[ i ];
 		}
 
+		// zero-pad if needed
+		std::fill( impl_->fft_input.begin( ) + copy_count, impl_->fft_input.end( ), 0.0f );
+
 		// FFT
-		kiss_fft( impl_->cfg, impl_->fft_input.data( ), impl_->fft_output.data( ) );
+		plan_->forward_real( impl_->fft_input.data( ), impl_->fft_output.data( ), impl_->fft_scratch.data( ) );
 
 		// compute magnitudes
+		update_magnitudes( static_cast< size_t >( fft_channel::left ), impl_->fft_output.data( ) );
+	}
+
+	void fft_processor::process_stereo( const sample_t* left, const sample_t* right, size_t sample_count )
+	{
+		refresh_plan( );
+
+		size_t copy_count   = std::min( sample_count, fft_size_ );
+		const float* window = window_->data( );
+
+		// z[n] = l[n] + i * r[n]
+		float* in = impl_->stereo_input.data( );
+		for ( size_t i = 0; i < copy_count; ++i ) {
+			in[ i * 2 ]     = left[ i ] * window[ i ];
+			in[ i * 2 + 1 ] = right[ i ] * window[ i ];
+		}
+
+		// zero-pad if needed
+		std::fill( impl_->stereo_input.begin( ) + copy_count * 2, impl_->stereo_input.end( ), 0.0f );
+
+		plan_->forward_complex( in, impl_->stereo_output.data( ) );
+
+		// L[k] = ( Z[k] + conj( Z[N-k] ) ) / 2
+		// R[k] = ( Z[k] - conj( Z[N-k] ) ) / 2i
+		const float* z = impl_->stereo_output.data( );
+		float* l_bins  = impl_->channel_bins[ static_cast< size_t >( fft_channel::left ) ].data( );
+		float* r_bins  = impl_->channel_bins[ static_cast< size_t >( fft_channel::right ) ].data( );
+		float* m_bins  = impl_->channel_bins[ static_cast< size_t >( fft_channel::mid ) ].data( );
+		float* s_bins  = impl_->channel_bins[ static_cast< size_t >( fft_channel::side ) ].data( );
+
+		for ( size_t k = 0; k < fft_size_ / 2; ++k ) {
+			const float* zk = z + k * 2;
+			const float* zn = z + ( ( fft_size_ - k ) % fft_size_ ) * 2;
+
+			float l_re = ( zk[ 0 ] + zn[ 0 ] ) * 0.5f;
+			float l_im = ( zk[ 1 ] - zn[ 1 ] ) * 0.5f;
+			float r_re = ( zk[ 1 ] + zn[ 1 ] ) * 0.5f;
+			float r_im = ( zn[ 0 ] - zk[ 0 ] ) * 0.5f;
+
+			l_bins[ k * 2 ]     = l_re;
+			l_bins[ k * 2 + 1 ] = l_im;
+			r_bins[ k * 2 ]     = r_re;
+			r_bins[ k * 2 + 1 ] = r_im;
+			m_bins[ k * 2 ]     = ( l_re + r_re ) * 0.5f;
+			m_bins[ k * 2 + 1 ] = ( l_im + r_im ) * 0.5f;
+			s_bins[ k * 2 ]     = ( l_re - r_re ) * 0.5f;
+			s_bins[ k * 2 + 1 ] = ( l_im - r_im ) * 0.5f;
+		}
+
+		for ( size_t ch = 0; ch < k_fft_channel_count; ++ch ) {
+			update_magnitudes( ch, impl_->channel_bins[ ch ].data( ) );
+		}
+	}
+
+	// bins are interleaved re/im pairs
+	void fft_processor::update_magnitudes( size_t channel, const float* bins )
+	{
 		const float scale  = 2.0f / static_cast< float >( fft_size_ );
 		const float min_db = -100.0f;
 
-		for ( size_t i = 0; i < fft_size_ / 2; ++i ) {
-			float re  = impl_->fft_output[ i ].r;
-			float im  = impl_->fft_output[ i ].i;
-			float mag = std::sqrt( re * re + im * im ) * scale;
+		float* magnitudes    = magnitudes_[ channel ].data( );
+		float* magnitudes_db = magnitudes_db_[ channel ].data( );
 
-			// apply smoothing
-			float prev_mag   = magnitudes_[ i ];
-			mag              = prev_mag * smoothing_ + mag * ( 1.0f - smoothing_ );
-			magnitudes_[ i ] = mag;
+		if ( power_smoothing_ && smoothing_ > 0.0f ) {
+			// the raw frame, then blended into the power accumulator
+			float* power = smoothed_power_[ channel ].data( );
+			magnitude_db( bins, fft_size_ / 2, scale, 0.0f, min_db, magnitudes, magnitudes_db );
+			average_power( magnitudes, fft_size_ / 2, smoothing_, power );
+			power_to_magnitude_db( power, fft_size_ / 2, min_db, magnitudes, magnitudes_db );
+		} else {
+			// power, smoothing and dB in one vectorised pass
+			magnitude_db( bins, fft_size_ / 2, scale, smoothing_, min_db, magnitudes, magnitudes_db );
+		}
 
-			// convert to dB
-			float db            = ( mag > 1e-10f ) ? 20.0f * std::log10( mag ) : min_db;
-			magnitudes_db_[ i ] = std::max( db, min_db );
+		if ( cumulative_enabled_ ) {
+			cumulative_stale_[ channel ] = true;
 		}
 	}
 
-	float fft_processor::get_magnitude( size_t bin ) const
+	void fft_processor::build_cumulative_power( size_t channel ) const
+	{
+		const float* mags  = magnitudes_[ channel ].data( );
+		double* cumulative = cumulative_power_[ channel ].data( );
+		double sum         = 0.0;
+
+		cumulative[ 0 ] = 0.0;
+		for ( size_t k = 0; k < fft_size_ / 2; ++k ) {
+			sum += static_cast< double >( mags[ k ] ) * mags[ k ];
+			cumulative[ k + 1 ] = sum;
+		}
+		cumulative_stale_[ channel ] = false;
+	}
+
+	const std::vector< double >& fft_processor::get_cumulative_power( fft_channel channel ) const
+	{
+		const size_t ch = static_cast< size_t >( channel );
+		if ( cumulative_stale_[ ch ] ) {
+			build_cumulative_power( ch );
+		}
+		return cumulative_power_[ ch ];
+	}
+
+	float fft_processor::get_band_power( float freq_start, float freq_end, fft_channel channel ) const
+	{
+		const auto& cumulative = get_cumulative_power( channel );
+		if ( cumulative.empty( ) )
+			return 0.0f;
+
+		// position in bin edges: bin k is centred on k * bin_width and spans
+		// [k, k + 1) here, the cumulative array is linear in between
+		const double bin_count = static_cast< double >( fft_size_ / 2 );
+		const double bin_width = static_cast< double >( sample_rate_ ) / static_cast< double >( fft_size_ );
+
+		auto edge_sum = [ & ]( double x ) {
+			size_t i = std::min( static_cast< size_t >( x ), fft_size_ / 2 - 1 );
+			return cumulative[ i ] + ( x - static_cast< double >( i ) ) * ( cumulative[ i + 1 ] - cumulative[ i ] );
+		};
+
+		double x0 = std::clamp( freq_start / bin_width + 0.5, 0.0, bin_count );
+		double x1 = std::clamp( freq_end / bin_width + 0.5, 0.0, bin_count );
+
+		// empty band (or clamped away): the power of the bin it sits in
+		if ( x1 <= x0 ) {
+			size_t bin = std::min( static_cast< size_t >( x0 ), fft_size_ / 2 - 1 );
+			return static_cast< float >( cumulative[ bin + 1 ] - cumulative[ bin ] );
+		}
+
+		return static_cast< float >( ( edge_sum( x1 ) - edge_sum( x0 ) ) / ( x1 - x0 ) );
+	}
+
+	float fft_processor::get_magnitude( size_t bin, fft_channel channel ) const
 	{
-		if ( bin >= magnitudes_.size( ) )
+		const auto& mags = magnitudes_[ static_cast< size_t >( channel ) ];
+		if ( bin >= mags.size( ) )
 			return 0.0f;
-		return magnitudes_[ bin ];
+		return mags[ bin ];
 	}
 
-	float fft_processor::get_magnitude_db( size_t bin ) const
+	float fft_processor::get_magnitude_db( size_t bin, fft_channel channel ) const
 	{
-		if ( bin >= magnitudes_db_.size( ) )
+		const auto& mags_db = magnitudes_db_[ static_cast< size_t >( channel ) ];
+		if ( bin >= mags_db.size( ) )
 			return -100.0f;
-		return magnitudes_db_[ bin ];
+		return mags_db[ bin ];
 	}
 
 	float fft_processor::get_frequency( size_t bin ) const
@@ -3,25 +3,31 @@
 // FFT processing via KissFFT
 
 #include "../common/types.h"
+#include "fft_plan_cache.h"
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace pm
 {
 
-	enum class fft_window_type {
-		none,
-		hann,
-		hamming,
-		blackman
-	};
-
 	enum class fft_scale_type {
 		linear,
 		logarithmic,
 		mel
 	};
 
+	// spectra published by the processor. process() fills left only,
+	// process_stereo() fills all four from a single complex transform
+	enum class fft_channel {
+		left,
+		right,
+		mid,
+		side
+	};
+
+	constexpr size_t k_fft_channel_count = 4;
+
 	class fft_processor
 	{
 	public:
@@ -31,21 +37,39 @@ namespace pm
 		// process samples and compute FFT
 		void process( const sample_t* input, size_t sample_count );
 
+		// process a stereo pair: L is packed into the real part and R into the
+		// imaginary part of one complex FFT, the two spectra are separated using
+		// conjugate symmetry and M/S are derived from them linearly
+		void process_stereo( const sample_t* left, const sample_t* right, size_t sample_count );
+
 		// get results
-		float get_magnitude( size_t bin ) const;
-		float get_magnitude_db( size_t bin ) const;
+		float get_magnitude( size_t bin, fft_channel channel = fft_channel::left ) const;
+		float get_magnitude_db( size_t bin, fft_channel channel = fft_channel::left ) const;
 		float get_frequency( size_t bin ) const;
 
 		// get all magnitudes
-		const std::vector< float >& get_magnitudes( ) const
+		const std::vector< float >& get_magnitudes( fft_channel channel = fft_channel::left ) const
 		{
-			return magnitudes_;
+			return magnitudes_[ static_cast< size_t >( channel ) ];
 		}
-		const std::vector< float >& get_magnitudes_db( ) const
+		const std::vector< float >& get_magnitudes_db( fft_channel channel = fft_channel::left ) const
 		{
-			return magnitudes_db_;
+			return magnitudes_db_[ static_cast< size_t >( channel ) ];
 		}
 
+		// optional running sum of magnitude^2, bin_count + 1 entries with
+		// cumulative[ k ] = sum of power over bins [0, k). double so narrow high
+		// bands survive the subtraction next to a loud low end. built on the
+		// first query after each frame, so only channels that are read pay for
+		// the scan (stereo frames produce four, callers usually read one)
+		void set_cumulative_power( bool enabled );
+		const std::vector< double >& get_cumulative_power( fft_channel channel = fft_channel::left ) const;
+
+		// O(1) mean power over [freq_start, freq_end) from the cumulative array,
+		// bins weighted by how much of them the band covers. requires
+		// set_cumulative_power( true )
+		float get_band_power( float freq_start, float freq_end, fft_channel channel = fft_channel::left ) const;
+
 		// configuration
 		void set_fft_size( size_t size );
 		size_t get_fft_size( ) const
@@ -57,7 +81,12 @@ namespace pm
 			return fft_size_ / 2;
 		}
 
+		// plans and windows come from fft_plan_cache, so after prewarm( ) and
+		// reserve( ) both of these are a pointer swap plus in-capacity resizes
 		void set_window_type( fft_window_type type );
+
+		// pre-size the buffers for the largest FFT this processor will switch to
+		void reserve( size_t max_fft_size );
 		void set_sample_rate( int sample_rate )
 		{
 			sample_rate_ = sample_rate;
@@ -73,6 +102,10 @@ namespace pm
 			smoothing_ = smoothing;
 		}
 
+		// smooth power instead of magnitude, the way spectral_averager does,
+		// so one time constant gives the same ballistics on every source
+		void set_power_smoothing( bool enabled );
+
 	private:
 		struct impl;
 		std::unique_ptr< impl > impl_;
@@ -81,13 +114,21 @@ namespace pm
 		int sample_rate_             = k_default_sample_rate;
 		fft_window_type window_type_ = fft_window_type::hann;
 		float smoothing_             = 0.8f;
-
-		std::vector< float > window_;
-		std::vector< float > magnitudes_;
-		std::vector< float > magnitudes_db_;
-		std::vector< sample_t > input_buffer_;
-
-		void compute_window( );
+		bool cumulative_enabled_     = false;
+		bool power_smoothing_        = false;
+
+		std::shared_ptr< const fft_plan > plan_;
+		uint32_t plan_generation_ = 0; // fft_plan_cache generation plan_ came from
+		std::shared_ptr< const fft_window_table > window_;
+		std::array< std::vector< float >, k_fft_channel_count > magnitudes_;
+		std::array< std::vector< float >, k_fft_channel_count > magnitudes_db_;
+		std::array< std::vector< float >, k_fft_channel_count > smoothed_power_; // set_power_smoothing( true ) only
+		mutable std::array< std::vector< double >, k_fft_channel_count > cumulative_power_;
+		mutable std::array< bool, k_fft_channel_count > cumulative_stale_{ };
+
+		void refresh_plan( );
+		void build_cumulative_power( size_t channel ) const;
+		void update_magnitudes( size_t channel, const float* bins );
 	};
 
 } // namespace pm
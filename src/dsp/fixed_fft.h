@@ -0,0 +1,319 @@
+#pragma once
+
+// compile-time specialised power-of-two complex FFT kernels
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace pm
+{
+
+	namespace fixed_fft_detail
+	{
+
+		constexpr double k_pi = 3.14159265358979323846;
+
+		// taylor series, only ever evaluated on [0, pi/4] where 8 terms are
+		// exact to double precision
+		constexpr double sin_poly( double x )
+		{
+			double x2   = x * x;
+			double term = x;
+			double sum  = x;
+			for ( int n = 1; n < 8; ++n ) {
+				term *= -x2 / static_cast< double >( ( 2 * n ) * ( 2 * n + 1 ) );
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr double cos_poly( double x )
+		{
+			double x2   = x * x;
+			double term = 1.0;
+			double sum  = 1.0;
+			for ( int n = 1; n < 8; ++n ) {
+				term *= -x2 / static_cast< double >( ( 2 * n - 1 ) * ( 2 * n ) );
+				sum += term;
+			}
+			return sum;
+		}
+
+		constexpr size_t log2( size_t n )
+		{
+			size_t bits = 0;
+			while ( n > 1 ) {
+				n >>= 1;
+				bits++;
+			}
+			return bits;
+		}
+
+		// cos / sin of 2 pi k / N for the first octant, every other angle is
+		// an exact symmetry of these, which keeps constant evaluation cheap
+		template< size_t N >
+		struct octant {
+			std::array< double, N / 8 + 1 > c{ };
+			std::array< double, N / 8 + 1 > s{ };
+
+			constexpr octant( )
+			{
+				for ( size_t k = 0; k <= N / 8; ++k ) {
+					double angle = 2.0 * k_pi * static_cast< double >( k ) / static_cast< double >( N );
+					c[ k ]       = cos_poly( angle );
+					s[ k ]       = sin_poly( angle );
+				}
+			}
+
+			// e^{-2 pi i k / N} = ( re, im )
+			constexpr void twiddle( size_t k, double& re, double& im ) const
+			{
+				k %= N;
+				size_t quadrant = k / ( N / 4 );
+				size_t r        = k % ( N / 4 );
+
+				double cs = 0.0, sn = 0.0;
+				if ( r <= N / 8 ) {
+					cs = c[ r ];
+					sn = s[ r ];
+				} else {
+					cs = s[ N / 4 - r ];
+					sn = c[ N / 4 - r ];
+				}
+
+				// rotate by quadrant * pi / 2
+				double rc = cs, rs = sn;
+				switch ( quadrant ) {
+				case 1:
+					rc = -sn;
+					rs = cs;
+					break;
+				case 2:
+					rc = -cs;
+					rs = -sn;
+					break;
+				case 3:
+					rc = sn;
+					rs = -cs;
+					break;
+				default:
+					break;
+				}
+
+				re = rc;
+				im = -rs;
+			}
+		};
+
+		// quarter span of the first radix-4 pass: radix-8 first pass when
+		// log2( N ) is odd, a twiddle-free radix-4 pass when it is even
+		template< size_t N >
+		constexpr size_t first_span( )
+		{
+			return ( log2( N ) % 2 ) ? 8 : 4;
+		}
+
+		// one ( w, w^2, w^3 ) triple per butterfly of every twiddled radix-4 pass
+		template< size_t N >
+		constexpr size_t twiddle_count( )
+		{
+			size_t count = 0;
+			for ( size_t m = first_span< N >( ); m * 4 <= N; m *= 4 ) {
+				count += m * 3;
+			}
+			return count;
+		}
+
+		// pass tables stored back to back, each contiguous in j, interleaved re/im
+		template< size_t N >
+		constexpr std::array< float, twiddle_count< N >( ) * 2 > make_twiddles( )
+		{
+			constexpr octant< N > table;
+			std::array< float, twiddle_count< N >( ) * 2 > out{ };
+
+			size_t pos = 0;
+			for ( size_t m = first_span< N >( ); m * 4 <= N; m *= 4 ) {
+				// w = e^{-2 pi i / 4m}, i.e. step N / 4m in the size-N table
+				size_t stride = N / ( m * 4 );
+				for ( size_t j = 0; j < m; ++j ) {
+					for ( size_t p = 1; p <= 3; ++p ) {
+						double re = 0.0, im = 0.0;
+						table.twiddle( j * p * stride, re, im );
+						out[ pos++ ] = static_cast< float >( re );
+						out[ pos++ ] = static_cast< float >( im );
+					}
+				}
+			}
+			return out;
+		}
+
+		template< size_t N >
+		constexpr std::array< uint16_t, N > make_bit_reversal( )
+		{
+			std::array< uint16_t, N > out{ };
+			constexpr size_t bits = log2( N );
+
+			// reverse( i ) from reverse( i / 2 ), one step per entry
+			for ( size_t i = 1; i < N; ++i ) {
+				out[ i ] = static_cast< uint16_t >( ( out[ i >> 1 ] >> 1 ) | ( ( i & 1 ) << ( bits - 1 ) ) );
+			}
+			return out;
+		}
+
+	} // namespace fixed_fft_detail
+
+	// forward complex FFT of a size fixed at compile time: bit-reversed copy,
+	// one radix-8 or twiddle-free radix-4 pass, then unrolled radix-4 passes
+	// whose twiddles and permutation are constexpr tables in read-only data.
+	// nothing is derived at run time and there is no mutable state, so any
+	// number of threads can call forward( ) at once
+	template< size_t N >
+	class fixed_fft
+	{
+		static_assert( N >= 8 && N <= 65536 && ( N & ( N - 1 ) ) == 0, "fixed_fft needs a power of two in [8, 65536]" );
+
+	public:
+		// interleaved re/im, input and output must not alias
+		static void forward( const float* input, float* output )
+		{
+			for ( size_t k = 0; k < N; ++k ) {
+				const size_t src    = static_cast< size_t >( k_reversal[ k ] ) * 2;
+				output[ k * 2 ]     = input[ src ];
+				output[ k * 2 + 1 ] = input[ src + 1 ];
+			}
+
+			if constexpr ( fixed_fft_detail::first_span< N >( ) == 8 ) {
+				radix8_pass( output );
+			} else {
+				radix4_first_pass( output );
+			}
+
+			const float* tw = k_twiddles.data( );
+			for ( size_t m = fixed_fft_detail::first_span< N >( ); m * 4 <= N; m *= 4 ) {
+				radix4_pass( output, m, tw );
+				tw += m * 6;
+			}
+		}
+
+	private:
+		static constexpr auto k_twiddles = fixed_fft_detail::make_twiddles< N >( );
+		static constexpr auto k_reversal = fixed_fft_detail::make_bit_reversal< N >( );
+
+		// groups of 4 with every twiddle equal to 1
+		static void radix4_first_pass( float* x )
+		{
+			for ( size_t g = 0; g < N * 2; g += 8 ) {
+				float* p = x + g;
+
+				float b0r = p[ 0 ] + p[ 2 ], b0i = p[ 1 ] + p[ 3 ];
+				float b1r = p[ 0 ] - p[ 2 ], b1i = p[ 1 ] - p[ 3 ];
+				float u2r = p[ 4 ] + p[ 6 ], u2i = p[ 5 ] + p[ 7 ];
+				float u3r = p[ 4 ] - p[ 6 ], u3i = p[ 5 ] - p[ 7 ];
+
+				p[ 0 ] = b0r + u2r;
+				p[ 1 ] = b0i + u2i;
+				p[ 4 ] = b0r - u2r;
+				p[ 5 ] = b0i - u2i;
+				p[ 2 ] = b1r + u3i;
+				p[ 3 ] = b1i - u3r;
+				p[ 6 ] = b1r - u3i;
+				p[ 7 ] = b1i + u3r;
+			}
+		}
+
+		// 8-point DFT per group (three radix-2 stages on bit-reversed data)
+		static void radix8_pass( float* x )
+		{
+			constexpr float h = 0.70710678118654752f;
+
+			for ( size_t g = 0; g < N * 2; g += 16 ) {
+				float* p = x + g;
+
+				// span 1
+				float y0r = p[ 0 ] + p[ 2 ], y0i = p[ 1 ] + p[ 3 ];
+				float y1r = p[ 0 ] - p[ 2 ], y1i = p[ 1 ] - p[ 3 ];
+				float y2r = p[ 4 ] + p[ 6 ], y2i = p[ 5 ] + p[ 7 ];
+				float y3r = p[ 4 ] - p[ 6 ], y3i = p[ 5 ] - p[ 7 ];
+				float y4r = p[ 8 ] + p[ 10 ], y4i = p[ 9 ] + p[ 11 ];
+				float y5r = p[ 8 ] - p[ 10 ], y5i = p[ 9 ] - p[ 11 ];
+				float y6r = p[ 12 ] + p[ 14 ], y6i = p[ 13 ] + p[ 15 ];
+				float y7r = p[ 12 ] - p[ 14 ], y7i = p[ 13 ] - p[ 15 ];
+
+				// span 2, odd elements rotated by -i
+				float z0r = y0r + y2r, z0i = y0i + y2i;
+				float z2r = y0r - y2r, z2i = y0i - y2i;
+				float z1r = y1r + y3i, z1i = y1i - y3r;
+				float z3r = y1r - y3i, z3i = y1i + y3r;
+				float z4r = y4r + y6r, z4i = y4i + y6i;
+				float z6r = y4r - y6r, z6i = y4i - y6i;
+				float z5r = y5r + y7i, z5i = y5i - y7r;
+				float z7r = y5r - y7i, z7i = y5i + y7r;
+
+				// span 4: twiddles 1, ( 1 - i ) h, -i, ( -1 - i ) h
+				float t5r = ( z5r + z5i ) * h, t5i = ( z5i - z5r ) * h;
+				float t6r = z6i, t6i = -z6r;
+				float t7r = ( z7i - z7r ) * h, t7i = -( z7r + z7i ) * h;
+
+				p[ 0 ]  = z0r + z4r;
+				p[ 1 ]  = z0i + z4i;
+				p[ 8 ]  = z0r - z4r;
+				p[ 9 ]  = z0i - z4i;
+				p[ 2 ]  = z1r + t5r;
+				p[ 3 ]  = z1i + t5i;
+				p[ 10 ] = z1r - t5r;
+				p[ 11 ] = z1i - t5i;
+				p[ 4 ]  = z2r + t6r;
+				p[ 5 ]  = z2i + t6i;
+				p[ 12 ] = z2r - t6r;
+				p[ 13 ] = z2i - t6i;
+				p[ 6 ]  = z3r + t7r;
+				p[ 7 ]  = z3i + t7i;
+				p[ 14 ] = z3r - t7r;
+				p[ 15 ] = z3i - t7i;
+			}
+		}
+
+		// combines two radix-2 stages (spans m and 2m) with three complex
+		// multiplies per butterfly: c1 = w^2 a1, c2 = w a2, c3 = w^3 a3
+		static void radix4_pass( float* x, size_t m, const float* tw )
+		{
+			const size_t group = m * 8; // 4m complex values
+
+			for ( size_t g = 0; g < N * 2; g += group ) {
+				float* p0 = x + g;
+				float* p1 = p0 + m * 2;
+				float* p2 = p1 + m * 2;
+				float* p3 = p2 + m * 2;
+
+				for ( size_t j = 0; j < m; ++j ) {
+					const float* w = tw + j * 6;
+					const size_t r = j * 2;
+					const size_t i = r + 1;
+
+					float c1r = p1[ r ] * w[ 2 ] - p1[ i ] * w[ 3 ];
+					float c1i = p1[ r ] * w[ 3 ] + p1[ i ] * w[ 2 ];
+					float c2r = p2[ r ] * w[ 0 ] - p2[ i ] * w[ 1 ];
+					float c2i = p2[ r ] * w[ 1 ] + p2[ i ] * w[ 0 ];
+					float c3r = p3[ r ] * w[ 4 ] - p3[ i ] * w[ 5 ];
+					float c3i = p3[ r ] * w[ 5 ] + p3[ i ] * w[ 4 ];
+
+					float b0r = p0[ r ] + c1r, b0i = p0[ i ] + c1i;
+					float b1r = p0[ r ] - c1r, b1i = p0[ i ] - c1i;
+					float u2r = c2r + c3r, u2i = c2i + c3i;
+					float u3r = c2r - c3r, u3i = c2i - c3i;
+
+					p0[ r ] = b0r + u2r;
+					p0[ i ] = b0i + u2i;
+					p2[ r ] = b0r - u2r;
+					p2[ i ] = b0i - u2i;
+					p1[ r ] = b1r + u3i;
+					p1[ i ] = b1i - u3r;
+					p3[ r ] = b1r - u3i;
+					p3[ i ] = b1i + u3r;
+				}
+			}
+		}
+	};
+
+} // namespace pm
@@ -0,0 +1,80 @@
+#include "halfband_decimator.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace pm
+{
+
+	static constexpr size_t k_halfband_taps   = 31;
+	static constexpr size_t k_halfband_center = k_halfband_taps / 2;
+
+	static const std::array< float, k_halfband_taps >& halfband_coefficients( )
+	{
+		static const std::array< float, k_halfband_taps > coeffs = [ ] {
+			std::array< float, k_halfband_taps > h{ };
+			const double pi = 3.14159265358979323846;
+			double sum      = 0.0;
+
+			std::array< double, k_halfband_taps > taps{ };
+			for ( size_t i = 0; i < k_halfband_taps; ++i ) {
+				double n = static_cast< double >( i ) - static_cast< double >( k_halfband_center );
+				double x = static_cast< double >( i ) / static_cast< double >( k_halfband_taps - 1 );
+				double w = 0.42 - 0.5 * std::cos( 2.0 * pi * x ) + 0.08 * std::cos( 4.0 * pi * x );
+				double s = ( n == 0.0 ) ? 0.5 : std::sin( pi * n * 0.5 ) / ( pi * n );
+
+				taps[ i ] = s * w;
+				sum += taps[ i ];
+			}
+
+			for ( size_t i = 0; i < k_halfband_taps; ++i ) {
+				h[ i ] = static_cast< float >( taps[ i ] / sum );
+			}
+			return h;
+		}( );
+		return coeffs;
+	}
+
+	halfband_decimator::halfband_decimator( int channels ) : channels_( channels ), history_( channels * k_halfband_taps * 2, 0.0f ) { }
+
+	void halfband_decimator::reset( )
+	{
+		std::fill( history_.begin( ), history_.end( ), 0.0f );
+		pos_   = 0;
+		phase_ = false;
+	}
+
+	size_t halfband_decimator::process( const sample_t* input, size_t frame_count, sample_t* output )
+	{
+		const auto& h  = halfband_coefficients( );
+		size_t written = 0;
+
+		for ( size_t i = 0; i < frame_count; ++i ) {
+			for ( int ch = 0; ch < channels_; ++ch ) {
+				float* hist                    = history_.data( ) + ch * k_halfband_taps * 2;
+				hist[ pos_ ]                   = input[ i * channels_ + ch ];
+				hist[ pos_ + k_halfband_taps ] = input[ i * channels_ + ch ];
+			}
+			pos_   = ( pos_ + 1 ) % k_halfband_taps;
+			phase_ = !phase_;
+
+			if ( phase_ )
+				continue;
+
+			// oldest sample at hist[ pos_ ], newest at hist[ pos_ + taps - 1 ]
+			for ( int ch = 0; ch < channels_; ++ch ) {
+				const float* window = history_.data( ) + ch * k_halfband_taps * 2 + pos_;
+
+				float acc = h[ k_halfband_center ] * window[ k_halfband_center ];
+				for ( size_t t = 0; t < k_halfband_taps; t += 2 ) {
+					acc += h[ t ] * window[ t ];
+				}
+				output[ written * channels_ + ch ] = acc;
+			}
+			written++;
+		}
+
+		return written;
+	}
+
+} // namespace pm
@@ -0,0 +1,38 @@
+#pragma once
+
+// decimate-by-2 half-band lowpass for interleaved multichannel streams
+
+#include "../common/types.h"
+#include <vector>
+
+namespace pm
+{
+
+	// 31-tap half-band lowpass (blackman windowed sinc). every other tap except
+	// the centre is zero, ~-70 dB stopband, passband flat to ~0.16 * input rate.
+	// only the kept outputs are computed and the zero taps are skipped. history
+	// is stored twice so the window never wraps
+	class halfband_decimator
+	{
+	public:
+		explicit halfband_decimator( int channels );
+
+		void reset( );
+
+		// interleaved in/out, returns the number of output frames (at most
+		// ( frame_count + 1 ) / 2). input and output may be the same buffer
+		size_t process( const sample_t* input, size_t frame_count, sample_t* output );
+
+		int get_channels( ) const
+		{
+			return channels_;
+		}
+
+	private:
+		int channels_;
+		std::vector< float > history_;
+		size_t pos_ = 0;
+		bool phase_ = false;
+	};
+
+} // namespace pm
@@ -0,0 +1,295 @@
+#include "level_stats.h"
+#include "simd.h"
+#include <limits>
+#include <numeric>
+
+namespace pm
+{
+
+	// interleaved layouts up to this many channels take the vector path
+	static constexpr int k_max_vector_channels = 8;
+
+	// lcm( channels, width ) for channels <= 8 and width <= 8
+	static constexpr int k_max_period = 64;
+
+	// accumulates periods blocks of period floats (vectors * width lanes each),
+	// lane p of every block into mins/maxs/sums/squares[ p ]
+	using accumulate_fn = void ( * )( const float*, size_t, float*, float*, double*, double* );
+
+	static void merge_lane( channel_stats& out, float min, float max, double sum, double squares )
+	{
+		out.min = std::min( out.min, min );
+		out.max = std::max( out.max, max );
+		out.sum += sum;
+		out.sum_squares += squares;
+	}
+
+	static void accumulate_scalar( const sample_t* data, size_t first, size_t last, int channels, channel_stats* out, int measured )
+	{
+		for ( size_t j = first; j < last; ++j ) {
+			const int ch = static_cast< int >( j % static_cast< size_t >( channels ) );
+			if ( ch < measured ) {
+				const float x = data[ j ];
+				merge_lane( out[ ch ], x, x, x, static_cast< double >( x ) * x );
+			}
+		}
+	}
+
+#if defined( PM_SIMD_X86 )
+
+	template< int Vectors >
+	static void accumulate_sse2( const float* data, size_t periods, float* mins, float* maxs, double* sums, double* squares )
+	{
+		__m128 mn[ Vectors ], mx[ Vectors ];
+		__m128d s[ Vectors * 2 ], q[ Vectors * 2 ];
+		for ( int v = 0; v < Vectors; ++v ) {
+			mn[ v ]         = _mm_loadu_ps( mins + v * 4 );
+			mx[ v ]         = _mm_loadu_ps( maxs + v * 4 );
+			s[ v * 2 ]      = _mm_loadu_pd( sums + v * 4 );
+			s[ v * 2 + 1 ]  = _mm_loadu_pd( sums + v * 4 + 2 );
+			q[ v * 2 ]      = _mm_loadu_pd( squares + v * 4 );
+			q[ v * 2 + 1 ]  = _mm_loadu_pd( squares + v * 4 + 2 );
+		}
+
+		for ( size_t p = 0; p < periods; ++p ) {
+			const float* block = data + p * Vectors * 4;
+			for ( int v = 0; v < Vectors; ++v ) {
+				const __m128 x   = _mm_loadu_ps( block + v * 4 );
+				const __m128d lo = _mm_cvtps_pd( x );
+				const __m128d hi = _mm_cvtps_pd( _mm_movehl_ps( x, x ) );
+
+				mn[ v ]        = _mm_min_ps( mn[ v ], x );
+				mx[ v ]        = _mm_max_ps( mx[ v ], x );
+				s[ v * 2 ]     = _mm_add_pd( s[ v * 2 ], lo );
+				s[ v * 2 + 1 ] = _mm_add_pd( s[ v * 2 + 1 ], hi );
+				q[ v * 2 ]     = _mm_add_pd( q[ v * 2 ], _mm_mul_pd( lo, lo ) );
+				q[ v * 2 + 1 ] = _mm_add_pd( q[ v * 2 + 1 ], _mm_mul_pd( hi, hi ) );
+			}
+		}
+
+		for ( int v = 0; v < Vectors; ++v ) {
+			_mm_storeu_ps( mins + v * 4, mn[ v ] );
+			_mm_storeu_ps( maxs + v * 4, mx[ v ] );
+			_mm_storeu_pd( sums + v * 4, s[ v * 2 ] );
+			_mm_storeu_pd( sums + v * 4 + 2, s[ v * 2 + 1 ] );
+			_mm_storeu_pd( squares + v * 4, q[ v * 2 ] );
+			_mm_storeu_pd( squares + v * 4 + 2, q[ v * 2 + 1 ] );
+		}
+	}
+
+	template< int Vectors >
+	PM_TARGET_AVX2 static void accumulate_avx2( const float* data, size_t periods, float* mins, float* maxs, double* sums, double* squares )
+	{
+		__m256 mn[ Vectors ], mx[ Vectors ];
+		__m256d s[ Vectors * 2 ], q[ Vectors * 2 ];
+		for ( int v = 0; v < Vectors; ++v ) {
+			mn[ v ]        = _mm256_loadu_ps( mins + v * 8 );
+			mx[ v ]        = _mm256_loadu_ps( maxs + v * 8 );
+			s[ v * 2 ]     = _mm256_loadu_pd( sums + v * 8 );
+			s[ v * 2 + 1 ] = _mm256_loadu_pd( sums + v * 8 + 4 );
+			q[ v * 2 ]     = _mm256_loadu_pd( squares + v * 8 );
+			q[ v * 2 + 1 ] = _mm256_loadu_pd( squares + v * 8 + 4 );
+		}
+
+		for ( size_t p = 0; p < periods; ++p ) {
+			const float* block = data + p * Vectors * 8;
+			for ( int v = 0; v < Vectors; ++v ) {
+				const __m256 x   = _mm256_loadu_ps( block + v * 8 );
+				const __m256d lo = _mm256_cvtps_pd( _mm256_castps256_ps128( x ) );
+				const __m256d hi = _mm256_cvtps_pd( _mm256_extractf128_ps( x, 1 ) );
+
+				mn[ v ]        = _mm256_min_ps( mn[ v ], x );
+				mx[ v ]        = _mm256_max_ps( mx[ v ], x );
+				s[ v * 2 ]     = _mm256_add_pd( s[ v * 2 ], lo );
+				s[ v * 2 + 1 ] = _mm256_add_pd( s[ v * 2 + 1 ], hi );
+				q[ v * 2 ]     = _mm256_fmadd_pd( lo, lo, q[ v * 2 ] );
+				q[ v * 2 + 1 ] = _mm256_fmadd_pd( hi, hi, q[ v * 2 + 1 ] );
+			}
+		}
+
+		for ( int v = 0; v < Vectors; ++v ) {
+			_mm256_storeu_ps( mins + v * 8, mn[ v ] );
+			_mm256_storeu_ps( maxs + v * 8, mx[ v ] );
+			_mm256_storeu_pd( sums + v * 8, s[ v * 2 ] );
+			_mm256_storeu_pd( sums + v * 8 + 4, s[ v * 2 + 1 ] );
+			_mm256_storeu_pd( squares + v * 8, q[ v * 2 ] );
+			_mm256_storeu_pd( squares + v * 8 + 4, q[ v * 2 + 1 ] );
+		}
+	}
+
+#elif defined( PM_SIMD_NEON )
+
+	template< int Vectors >
+	static void accumulate_neon( const float* data, size_t periods, float* mins, float* maxs, double* sums, double* squares )
+	{
+		float32x4_t mn[ Vectors ], mx[ Vectors ];
+		float64x2_t s[ Vectors * 2 ], q[ Vectors * 2 ];
+		for ( int v = 0; v < Vectors; ++v ) {
+			mn[ v ]        = vld1q_f32( mins + v * 4 );
+			mx[ v ]        = vld1q_f32( maxs + v * 4 );
+			s[ v * 2 ]     = vld1q_f64( sums + v * 4 );
+			s[ v * 2 + 1 ] = vld1q_f64( sums + v * 4 + 2 );
+			q[ v * 2 ]     = vld1q_f64( squares + v * 4 );
+			q[ v * 2 + 1 ] = vld1q_f64( squares + v * 4 + 2 );
+		}
+
+		for ( size_t p = 0; p < periods; ++p ) {
+			const float* block = data + p * Vectors * 4;
+			for ( int v = 0; v < Vectors; ++v ) {
+				const float32x4_t x  = vld1q_f32( block + v * 4 );
+				const float64x2_t lo = vcvt_f64_f32( vget_low_f32( x ) );
+				const float64x2_t hi = vcvt_high_f64_f32( x );
+
+				mn[ v ]        = vminq_f32( mn[ v ], x );
+				mx[ v ]        = vmaxq_f32( mx[ v ], x );
+				s[ v * 2 ]     = vaddq_f64( s[ v * 2 ], lo );
+				s[ v * 2 + 1 ] = vaddq_f64( s[ v * 2 + 1 ], hi );
+				q[ v * 2 ]     = vfmaq_f64( q[ v * 2 ], lo, lo );
+				q[ v * 2 + 1 ] = vfmaq_f64( q[ v * 2 + 1 ], hi, hi );
+			}
+		}
+
+		for ( int v = 0; v < Vectors; ++v ) {
+			vst1q_f32( mins + v * 4, mn[ v ] );
+			vst1q_f32( maxs + v * 4, mx[ v ] );
+			vst1q_f64( sums + v * 4, s[ v * 2 ] );
+			vst1q_f64( sums + v * 4 + 2, s[ v * 2 + 1 ] );
+			vst1q_f64( squares + v * 4, q[ v * 2 ] );
+			vst1q_f64( squares + v * 4 + 2, q[ v * 2 + 1 ] );
+		}
+	}
+
+#endif
+
+	// vectors per period for channels <= 8 is one of 1, 2, 3, 5 or 7
+	template< template< int > class Kernel >
+	static accumulate_fn select_vectors( int vectors )
+	{
+		switch ( vectors ) {
+		case 1:
+			return Kernel< 1 >::fn;
+		case 2:
+			return Kernel< 2 >::fn;
+		case 3:
+			return Kernel< 3 >::fn;
+		case 5:
+			return Kernel< 5 >::fn;
+		case 7:
+			return Kernel< 7 >::fn;
+		default:
+			return nullptr;
+		}
+	}
+
+#if defined( PM_SIMD_X86 )
+	template< int Vectors >
+	struct sse2_kernel {
+		static constexpr accumulate_fn fn = accumulate_sse2< Vectors >;
+	};
+	template< int Vectors >
+	struct avx2_kernel {
+		static constexpr accumulate_fn fn = accumulate_avx2< Vectors >;
+	};
+#elif defined( PM_SIMD_NEON )
+	template< int Vectors >
+	struct neon_kernel {
+		static constexpr accumulate_fn fn = accumulate_neon< Vectors >;
+	};
+#endif
+
+	struct accumulate_kernel {
+		int width                          = 0; // floats per vector, 0 = scalar only
+		accumulate_fn ( *select )( int )   = nullptr;
+	};
+
+	static accumulate_kernel resolve_accumulate( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return { 8, select_vectors< avx2_kernel > };
+		case simd::isa::sse2:
+			return { 4, select_vectors< sse2_kernel > };
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return { 4, select_vectors< neon_kernel > };
+#endif
+		default:
+			return { };
+		}
+	}
+
+	// statistics of the first measured channels of interleaved data into out
+	static void measure( const sample_t* data, size_t frames, int channels, channel_stats* out, int measured )
+	{
+		static const accumulate_kernel kernel = resolve_accumulate( );
+
+		constexpr float inf = std::numeric_limits< float >::infinity( );
+		for ( int ch = 0; ch < measured; ++ch ) {
+			out[ ch ] = { inf, -inf, 0.0, 0.0 };
+		}
+
+		const size_t total = frames * static_cast< size_t >( channels );
+		size_t done        = 0;
+
+		if ( kernel.width > 0 && channels <= k_max_vector_channels ) {
+			const int period = std::lcm( channels, kernel.width );
+			const accumulate_fn fn = kernel.select( period / kernel.width );
+
+			if ( fn ) {
+				alignas( 32 ) float mins[ k_max_period ];
+				alignas( 32 ) float maxs[ k_max_period ];
+				alignas( 32 ) double sums[ k_max_period ];
+				alignas( 32 ) double squares[ k_max_period ];
+				std::fill( mins, mins + period, inf );
+				std::fill( maxs, maxs + period, -inf );
+				std::fill( sums, sums + period, 0.0 );
+				std::fill( squares, squares + period, 0.0 );
+
+				const size_t periods = total / static_cast< size_t >( period );
+				fn( data, periods, mins, maxs, sums, squares );
+
+				// lane p of a period always holds channel p % channels
+				for ( int p = 0; p < period; ++p ) {
+					const int ch = p % channels;
+					if ( ch < measured ) {
+						merge_lane( out[ ch ], mins[ p ], maxs[ p ], sums[ p ], squares[ p ] );
+					}
+				}
+				done = periods * static_cast< size_t >( period );
+			}
+		}
+
+		// tail, or everything when there is no vector path. done is a whole
+		// number of frames, so j % channels is still the channel
+		accumulate_scalar( data, done, total, channels, out, measured );
+
+		if ( frames == 0 ) {
+			for ( int ch = 0; ch < measured; ++ch ) {
+				out[ ch ] = { };
+			}
+		}
+	}
+
+	void compute_level_stats( const sample_t* samples, size_t frames, int channels, level_stats& stats )
+	{
+		stats.frames   = frames;
+		stats.channels = std::clamp( channels, 0, level_stats::k_max_channels );
+		if ( channels < 1 )
+			return;
+
+		measure( samples, frames, channels, stats.channel, stats.channels );
+	}
+
+	void compute_level_stats_planar( const sample_t* const* planes, size_t frames, int channels, level_stats& stats )
+	{
+		stats.frames   = frames;
+		stats.channels = std::clamp( channels, 0, level_stats::k_max_channels );
+
+		// each plane is a mono interleaved stream
+		for ( int ch = 0; ch < stats.channels; ++ch ) {
+			measure( planes[ ch ], frames, 1, &stats.channel[ ch ], 1 );
+		}
+	}
+
+} // namespace pm
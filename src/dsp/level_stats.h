@@ -0,0 +1,56 @@
+#pragma once
+
+// fused single-pass level statistics (peak, RMS, DC, min/max) per channel
+
+#include "../common/types.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	struct channel_stats {
+		float min          = 0.0f;
+		float max          = 0.0f;
+		double sum         = 0.0; // for DC
+		double sum_squares = 0.0;
+
+		float get_peak( ) const
+		{
+			return std::max( -min, max );
+		}
+	};
+
+	// one block's statistics, computed once and read by every level meter
+	struct level_stats {
+		// channels beyond this are not measured
+		static constexpr int k_max_channels = 32;
+
+		size_t frames = 0;
+		int channels  = 0;
+		channel_stats channel[ k_max_channels ];
+
+		float get_peak( int ch ) const
+		{
+			return channel[ ch ].get_peak( );
+		}
+		float get_rms( int ch ) const
+		{
+			return ( frames > 0 ) ? static_cast< float >( std::sqrt( channel[ ch ].sum_squares / static_cast< double >( frames ) ) ) : 0.0f;
+		}
+		float get_dc( int ch ) const
+		{
+			return ( frames > 0 ) ? static_cast< float >( channel[ ch ].sum / static_cast< double >( frames ) ) : 0.0f;
+		}
+	};
+
+	// one pass over interleaved samples. the samples are read as one flat
+	// array whose lanes map to channels with a period of lcm( channels,
+	// vector width ), so any channel count vectorises without deinterleaving.
+	// min/max are tracked in float, sums in double
+	void compute_level_stats( const sample_t* samples, size_t frames, int channels, level_stats& stats );
+
+	// same for planar input, one array of frames samples per channel
+	void compute_level_stats_planar( const sample_t* const* planes, size_t frames, int channels, level_stats& stats );
+
+} // namespace pm
@@ -1,18 +1,16 @@
 #include "loudness.h"
+#include "level_stats.h"
 #include <algorithm>
 #include <cmath>
-#include <numeric>
 
 namespace pm
 {
 
 	float calculate_peak( const sample_t* samples, size_t count )
 	{
-		float peak = 0.0f;
-		for ( size_t i = 0; i < count; ++i ) {
-			peak = std::max( peak, std::abs( samples[ i ] ) );
-		}
-		return peak;
+		level_stats stats;
+		compute_level_stats( samples, count, 1, stats );
+		return stats.get_peak( 0 );
 	}
 
 	float calculate_peak_db( const sample_t* samples, size_t count )
@@ -25,14 +23,9 @@ namespace pm
 
 	float calculate_rms( const sample_t* samples, size_t count )
 	{
-		if ( count == 0 )
-			return 0.0f;
-
-		double sum = 0.0;
-		for ( size_t i = 0; i < count; ++i ) {
-			sum += samples[ i ] * samples[ i ];
-		}
-		return static_cast< float >( std::sqrt( sum / count ) );
+		level_stats stats;
+		compute_level_stats( samples, count, 1, stats );
+		return stats.get_rms( 0 );
 	}
 
 	float calculate_rms_db( const sample_t* samples, size_t count )
@@ -43,117 +36,324 @@ namespace pm
 		return 20.0f * std::log10( rms );
 	}
 
+	// gated loudness histogram
+
+	// BS.1770 relative gate for integrated loudness
+	static constexpr float k_integrated_relative_gate = -10.0f;
+
+	// EBU Tech 3342 loudness range: relative gate and the percentiles spanned
+	static constexpr float k_range_relative_gate = -20.0f;
+	static constexpr float k_range_low           = 0.10f;
+	static constexpr float k_range_high          = 0.95f;
+
+	static constexpr int k_histogram_bins =
+	    static_cast< int >( ( loudness_histogram::k_max_lufs - loudness_histogram::k_min_lufs ) / loudness_histogram::k_resolution + 0.5f );
+
+	static double lufs_to_energy( double lufs )
+	{
+		return std::pow( 10.0, ( lufs + 0.691 ) / 10.0 );
+	}
+
+	static double energy_to_lufs( double energy )
+	{
+		return -0.691 + 10.0 * std::log10( energy );
+	}
+
+	// bin holding a loudness value, -1 below the lowest edge
+	static int histogram_bin( double lufs )
+	{
+		const double position = ( lufs - loudness_histogram::k_min_lufs ) / loudness_histogram::k_resolution;
+		if ( position < 0.0 )
+			return -1;
+		return std::min( static_cast< int >( position ), k_histogram_bins - 1 );
+	}
+
+	loudness_histogram::loudness_histogram( ) : counts_( k_histogram_bins, 0 ), energy_( k_histogram_bins, 0.0 ) { }
+
+	void loudness_histogram::reset( )
+	{
+		std::fill( counts_.begin( ), counts_.end( ), 0 );
+		std::fill( energy_.begin( ), energy_.end( ), 0.0 );
+		total_count_  = 0;
+		total_energy_ = 0.0;
+	}
+
+	void loudness_histogram::add( double mean_square )
+	{
+		static const double absolute_gate = lufs_to_energy( k_min_lufs );
+		if ( !( mean_square > absolute_gate ) )
+			return;
+
+		const int bin = std::max( histogram_bin( energy_to_lufs( mean_square ) ), 0 );
+		counts_[ bin ]++;
+		energy_[ bin ] += mean_square;
+		total_count_++;
+		total_energy_ += mean_square;
+	}
+
+	int loudness_histogram::first_gated_bin( float relative_gate_lu ) const
+	{
+		const double threshold = energy_to_lufs( total_energy_ / static_cast< double >( total_count_ ) ) + relative_gate_lu;
+		const int bin          = histogram_bin( threshold );
+		if ( bin < 0 )
+			return 0;
+
+		// the bin holding the threshold goes in or out by its own mean
+		const double gate = lufs_to_energy( threshold );
+		return ( energy_[ bin ] > gate * static_cast< double >( counts_[ bin ] ) ) ? bin : bin + 1;
+	}
+
+	float loudness_histogram::get_gated_mean( float relative_gate_lu ) const
+	{
+		if ( total_count_ == 0 )
+			return -100.0f;
+
+		uint64_t count = 0;
+		double energy  = 0.0;
+		for ( int bin = first_gated_bin( relative_gate_lu ); bin < k_histogram_bins; ++bin ) {
+			count += counts_[ bin ];
+			energy += energy_[ bin ];
+		}
+
+		if ( count == 0 )
+			return -100.0f;
+		return static_cast< float >( energy_to_lufs( energy / static_cast< double >( count ) ) );
+	}
+
+	float loudness_histogram::get_gated_percentile( float relative_gate_lu, float fraction ) const
+	{
+		if ( total_count_ == 0 )
+			return -100.0f;
+
+		const int first = first_gated_bin( relative_gate_lu );
+
+		uint64_t count = 0;
+		for ( int bin = first; bin < k_histogram_bins; ++bin ) {
+			count += counts_[ bin ];
+		}
+		if ( count == 0 )
+			return -100.0f;
+
+		// rank into the sorted gated values, as in the nearest-rank definition
+		// of the tech doc, then spread the bin's blocks evenly across its width
+		const double rank = std::clamp( static_cast< double >( fraction ), 0.0, 1.0 ) * static_cast< double >( count - 1 );
+		double below      = 0.0;
+		for ( int bin = first; bin < k_histogram_bins; ++bin ) {
+			const double in_bin = static_cast< double >( counts_[ bin ] );
+			if ( in_bin > 0.0 && rank < below + in_bin ) {
+				const double position = ( rank - below + 0.5 ) / in_bin;
+				return k_min_lufs + ( static_cast< float >( bin ) + static_cast< float >( position ) ) * k_resolution;
+			}
+			below += in_bin;
+		}
+		return k_max_lufs;
+	}
+
 	// LUFS meter implementation
 
+	float get_channel_weight( int channels, int channel )
+	{
+		// mono, stereo and 3.0 are all front channels
+		if ( channels <= 3 || channel < 2 )
+			return 1.0f;
+
+		// quad: FL FR BL BR
+		if ( channels == 4 )
+			return 1.41f;
+
+		if ( channel == 2 )
+			return 1.0f;
+		if ( channel == 3 )
+			return ( channels >= 6 ) ? 0.0f : 1.41f;
+		return 1.41f;
+	}
+
 	lufs_meter::lufs_meter( int sample_rate ) : sample_rate_( sample_rate )
 	{
+		compute_filter_coefficients( );
+		set_channels( 2 );
+	}
+
+	void lufs_meter::set_channel_weights( const float* weights, int count )
+	{
+		if ( weights && count > 0 ) {
+			custom_weights_.assign( weights, weights + count );
+		} else {
+			custom_weights_.clear( );
+		}
+		set_channels( channels_ );
+	}
+
+	void lufs_meter::set_channels( int channels )
+	{
+		channels_ = std::max( channels, 1 );
+
+		const bool custom = static_cast< int >( custom_weights_.size( ) ) == channels_;
+		weights_.resize( channels_ );
+		for ( int ch = 0; ch < channels_; ++ch ) {
+			weights_[ ch ] = custom ? custom_weights_[ ch ] : get_channel_weight( channels_, ch );
+		}
+
+		filter_state_.resize( k_weighting_state_lines * channels_ );
+		block_sum_.resize( channels_ );
 		reset( );
 	}
 
 	void lufs_meter::set_sample_rate( int sample_rate )
 	{
 		sample_rate_ = sample_rate;
+		compute_filter_coefficients( );
 		reset( );
 	}
 
-	void lufs_meter::reset( )
+	void lufs_meter::compute_filter_coefficients( )
 	{
-		high_shelf_l_ = { };
-		high_shelf_r_ = { };
-		high_pass_l_  = { };
-		high_pass_r_  = { };
+		filter_ = make_k_weighting( sample_rate_ );
+	}
 
-		// momentary buffer: 400ms worth of 100ms blocks (4 blocks)
-		momentary_buffer_.clear( );
-		momentary_buffer_.reserve( 4 );
+	void lufs_meter::set_refresh_rate( int hz )
+	{
+		sub_blocks_ = std::clamp( ( hz + 5 ) / 10, 1, 10 );
+		reset( );
+	}
 
-		// short-term buffer: 3s worth of 100ms blocks (30 blocks)
-		short_term_buffer_.clear( );
-		short_term_buffer_.reserve( 30 );
+	void lufs_meter::block_window::resize( size_t capacity )
+	{
+		energy.assign( capacity, 0.0 );
+		samples.assign( capacity, 0 );
+		clear( );
+	}
 
-		integrated_sum_   = 0.0;
-		integrated_count_ = 0;
+	void lufs_meter::block_window::clear( )
+	{
+		std::fill( energy.begin( ), energy.end( ), 0.0 );
+		std::fill( samples.begin( ), samples.end( ), 0 );
+		head        = 0;
+		filled      = 0;
+		energy_sum  = 0.0;
+		samples_sum = 0;
+	}
+
+	void lufs_meter::block_window::push( double block_energy, size_t block_samples )
+	{
+		energy_sum += block_energy - energy[ head ];
+		samples_sum += block_samples - samples[ head ];
+		energy[ head ]  = block_energy;
+		samples[ head ] = block_samples;
+
+		filled = std::min( filled + 1, energy.size( ) );
+		if ( ++head == energy.size( ) ) {
+			head       = 0;
+			energy_sum = 0.0;
+			for ( double e : energy ) {
+				energy_sum += e;
+			}
+		}
+	}
+
+	void lufs_meter::reset( )
+	{
+		std::fill( filter_state_.begin( ), filter_state_.end( ), 0.0 );
+
+		// 400ms and 3s windows in sub-blocks
+		momentary_.resize( static_cast< size_t >( 4 * sub_blocks_ ) );
+		short_term_.resize( static_cast< size_t >( 30 * sub_blocks_ ) );
+
+		gating_blocks_.reset( );
+		short_term_blocks_.reset( );
 
 		momentary_lufs_  = -100.0f;
 		short_term_lufs_ = -100.0f;
 		integrated_lufs_ = -100.0f;
+		loudness_range_  = 0.0f;
+
+		max_momentary_lufs_  = -100.0f;
+		max_short_term_lufs_ = -100.0f;
 
 		block_samples_ = 0;
-		block_sum_l_   = 0.0;
-		block_sum_r_   = 0.0;
-	}
-
-	void lufs_meter::process( const sample_t* samples, size_t frame_count )
-	{
-		const size_t block_size = sample_rate_ / 10; // 100ms blocks
-
-		for ( size_t i = 0; i < frame_count; ++i ) {
-			// stereo samples
-			float left  = samples[ i * 2 ];
-			float right = samples[ i * 2 + 1 ];
-
-			// apply K-weighting (simplified - just sum squares for now)
-			// full implementation would use proper IIR filters
-			block_sum_l_ += left * left;
-			block_sum_r_ += right * right;
-			block_samples_++;
-
-			// when we have a complete 100ms block
-			if ( block_samples_ >= block_size ) {
-				// calculate mean square for this block
-				float mean_square = static_cast< float >( ( block_sum_l_ + block_sum_r_ ) / ( 2.0 * block_samples_ ) );
-
-				// add to momentary buffer (400ms = 4 blocks)
-				momentary_buffer_.push_back( mean_square );
-				if ( momentary_buffer_.size( ) > 4 ) {
-					momentary_buffer_.erase( momentary_buffer_.begin( ) );
-				}
-
-				// add to short-term buffer (3s = 30 blocks)
-				short_term_buffer_.push_back( mean_square );
-				if ( short_term_buffer_.size( ) > 30 ) {
-					short_term_buffer_.erase( short_term_buffer_.begin( ) );
-				}
-
-				// calculate momentary loudness (400ms)
-				if ( !momentary_buffer_.empty( ) ) {
-					float avg = std::accumulate( momentary_buffer_.begin( ), momentary_buffer_.end( ), 0.0f ) / momentary_buffer_.size( );
-					if ( avg > 1e-10f ) {
-						momentary_lufs_ = -0.691f + 10.0f * std::log10( avg );
-					} else {
-						momentary_lufs_ = -100.0f;
-					}
-				}
-
-				// calculate short-term loudness (3s)
-				if ( !short_term_buffer_.empty( ) ) {
-					float avg = std::accumulate( short_term_buffer_.begin( ), short_term_buffer_.end( ), 0.0f ) / short_term_buffer_.size( );
-					if ( avg > 1e-10f ) {
-						short_term_lufs_ = -0.691f + 10.0f * std::log10( avg );
-					} else {
-						short_term_lufs_ = -100.0f;
-					}
-				}
-
-				// update integrated loudness (gated)
-				// simplified: just accumulate blocks above -70 LUFS
-				float block_lufs = -0.691f + 10.0f * std::log10( mean_square + 1e-10f );
-				if ( block_lufs > -70.0f ) {
-					integrated_sum_ += mean_square;
-					integrated_count_++;
-
-					if ( integrated_count_ > 0 ) {
-						float avg        = static_cast< float >( integrated_sum_ / integrated_count_ );
-						integrated_lufs_ = -0.691f + 10.0f * std::log10( avg );
-					}
-				}
-
-				// reset block accumulators
-				block_samples_ = 0;
-				block_sum_l_   = 0.0;
-				block_sum_r_   = 0.0;
+		block_index_   = 0;
+		std::fill( block_sum_.begin( ), block_sum_.end( ), 0.0 );
+	}
+
+	size_t lufs_meter::get_block_size( int index ) const
+	{
+		// sub-block boundaries at floor( i * rate / blocks_per_second ), so
+		// every second holds exactly sample_rate_ samples whatever the step
+		const int64_t rate   = std::max( sample_rate_, 1 );
+		const int64_t blocks = 10 * sub_blocks_;
+		return static_cast< size_t >( std::max< int64_t >( ( index + 1 ) * rate / blocks - index * rate / blocks, 1 ) );
+	}
+
+	void lufs_meter::process( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return;
+		if ( channels != channels_ ) {
+			set_channels( channels );
+		}
+
+		size_t offset = 0;
+		while ( offset < frame_count ) {
+			// filter up to the end of the current sub-block in one kernel call
+			const size_t count = std::min( frame_count - offset, get_block_size( block_index_ ) - block_samples_ );
+			k_weighting( samples + offset * channels, count, channels, filter_, filter_state_.data( ), block_sum_.data( ) );
+			block_samples_ += count;
+			offset += count;
+
+			if ( block_samples_ >= get_block_size( block_index_ ) ) {
+				finish_block( );
 			}
 		}
 	}
 
+	static float to_lufs( double mean_square )
+	{
+		return ( mean_square > 1e-10 ) ? static_cast< float >( -0.691 + 10.0 * std::log10( mean_square ) ) : -100.0f;
+	}
+
+	void lufs_meter::finish_block( )
+	{
+		// weighted channel mean squares add up, they are not averaged
+		double energy = 0.0;
+		for ( int ch = 0; ch < channels_; ++ch ) {
+			energy += weights_[ ch ] * block_sum_[ ch ];
+		}
+		momentary_.push( energy, block_samples_ );
+		short_term_.push( energy, block_samples_ );
+
+		momentary_lufs_  = to_lufs( momentary_.get_mean_square( ) );
+		short_term_lufs_ = to_lufs( short_term_.get_mean_square( ) );
+
+		if ( momentary_.is_full( ) ) {
+			max_momentary_lufs_ = std::max( max_momentary_lufs_, momentary_lufs_ );
+		}
+		if ( short_term_.is_full( ) ) {
+			max_short_term_lufs_ = std::max( max_short_term_lufs_, short_term_lufs_ );
+		}
+
+		block_samples_ = 0;
+		block_index_   = ( block_index_ + 1 ) % ( 10 * sub_blocks_ );
+		std::fill( block_sum_.begin( ), block_sum_.end( ), 0.0 );
+
+		// gating runs on the 100ms grid whatever the refresh rate
+		if ( block_index_ % sub_blocks_ != 0 )
+			return;
+
+		// integrated loudness: the 400ms window is a gating block, with 75%
+		// overlap since it advances by 100ms
+		if ( momentary_.is_full( ) ) {
+			gating_blocks_.add( momentary_.get_mean_square( ) );
+			integrated_lufs_ = gating_blocks_.get_gated_mean( k_integrated_relative_gate );
+		}
+
+		// loudness range: short-term values at 10 Hz once the 3s window is full
+		if ( short_term_.is_full( ) ) {
+			short_term_blocks_.add( short_term_.get_mean_square( ) );
+
+			const float low  = short_term_blocks_.get_gated_percentile( k_range_relative_gate, k_range_low );
+			const float high = short_term_blocks_.get_gated_percentile( k_range_relative_gate, k_range_high );
+			loudness_range_  = ( short_term_blocks_.get_count( ) > 0 ) ? high - low : 0.0f;
+		}
+	}
+
 } // namespace pm
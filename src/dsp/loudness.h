@@ -1,5 +1,6 @@
 #pragma once
 #include "../common/types.h"
+#include "loudness_kernels.h"
 #include <vector>
 
 namespace pm
@@ -13,14 +14,63 @@ namespace pm
 	float calculate_rms( const sample_t* samples, size_t count );
 	float calculate_rms_db( const sample_t* samples, size_t count );
 
-	// LUFS (simplified ITU-R BS.1770 implementation)
+	// fixed-resolution histogram of block loudness for gated statistics.
+	// each bin keeps a block count and the exact sum of the blocks' mean
+	// squares, so power means over whole bins carry no quantisation error and
+	// only the bin straddling a relative gate is decided as a unit (by its
+	// mean). memory and add( ) are O(1) however long the program runs
+	class loudness_histogram
+	{
+	public:
+		static constexpr float k_min_lufs   = -70.0f; // absolute gate, also the lowest bin edge
+		static constexpr float k_max_lufs   = 10.0f;  // louder blocks share the top bin
+		static constexpr float k_resolution = 0.05f;  // LU per bin
+
+		loudness_histogram( );
+
+		// one gating block by its channel-weighted mean square. blocks at or
+		// below the absolute gate are not counted
+		void add( double mean_square );
+		void reset( );
+
+		size_t get_count( ) const
+		{
+			return static_cast< size_t >( total_count_ );
+		}
+
+		// power mean, in LUFS, of the counted blocks louder than the power
+		// mean of all counted blocks plus relative_gate_lu. -100 when empty
+		float get_gated_mean( float relative_gate_lu ) const;
+
+		// loudness, in LUFS, below which the given fraction (0..1) of the blocks
+		// that pass the same relative gate lie. interpolated within the bin, so
+		// it is good to a fraction of k_resolution. -100 when empty
+		float get_gated_percentile( float relative_gate_lu, float fraction ) const;
+
+	private:
+		std::vector< uint64_t > counts_;
+		std::vector< double > energy_;
+		uint64_t total_count_ = 0;
+		double total_energy_  = 0.0;
+
+		// first bin that passes the relative gate
+		int first_gated_bin( float relative_gate_lu ) const;
+	};
+
+	// BS.1770 channel weight G for the usual WAVE channel order (FL FR FC LFE
+	// BL BR SL SR, 4 channels = quad, 5 = 5.0): 1.0 for front channels, 1.41
+	// (~+1.5 dB) for surrounds, 0 for LFE
+	float get_channel_weight( int channels, int channel );
+
+	// LUFS (ITU-R BS.1770, K-weighted)
 	class lufs_meter
 	{
 	public:
 		explicit lufs_meter( int sample_rate = k_default_sample_rate );
 
-		// process stereo samples (interleaved L/R)
-		void process( const sample_t* samples, size_t frame_count );
+		// process interleaved samples, any channel count. a change of channel
+		// count starts a new measurement
+		void process( const sample_t* samples, size_t frame_count, int channels = 2 );
 
 		// reset the meter
 		void reset( );
@@ -37,37 +87,100 @@ namespace pm
 		float get_integrated( ) const
 		{
 			return integrated_lufs_;
-		} // full program
+		} // full program, two-stage gated
+		float get_loudness_range( ) const
+		{
+			return loudness_range_;
+		} // EBU Tech 3342 LRA, in LU
+
+		// highest momentary / short-term value since reset, counted once the
+		// window has filled
+		float get_max_momentary( ) const
+		{
+			return max_momentary_lufs_;
+		}
+		float get_max_short_term( ) const
+		{
+			return max_short_term_lufs_;
+		}
 
 		void set_sample_rate( int sample_rate );
 
+		// per-channel gains G, used for streams of exactly count channels in
+		// place of get_channel_weight( ). nullptr restores the defaults
+		void set_channel_weights( const float* weights, int count );
+
+		// momentary and short-term refresh rate, 10..100 Hz in steps of 10.
+		// the windows slide by 100ms / ( hz / 10 ) sub-blocks, gating for the
+		// integrated value and LRA stays on the standard 100ms step. resets
+		void set_refresh_rate( int hz );
+		int get_refresh_rate( ) const
+		{
+			return sub_blocks_ * 10;
+		}
+
 	private:
 		int sample_rate_;
+		int sub_blocks_ = 1; // per 100ms
+		int channels_   = 2;
+
+		std::vector< float > weights_;        // per channel of the current stream
+		std::vector< float > custom_weights_; // from set_channel_weights( )
 
-		// K-weighting filter state
-		struct filter_state {
-			double z1 = 0.0, z2 = 0.0;
+		// K-weighting filter, coefficients follow the sample rate
+		k_weighting_coefficients filter_;
+		std::vector< double > filter_state_; // k_weighting_state_lines * channels_
+
+		// sliding window over the newest sub-blocks with running sums, so
+		// each step is O(1). sample counts are carried along because sub-blocks
+		// at rates not divisible by the step differ by a sample. the energy sum
+		// is recomputed whenever the ring wraps, which bounds rounding drift at
+		// amortised O(1) cost
+		struct block_window {
+			std::vector< double > energy; // K-weighted sum of squares per sub-block
+			std::vector< size_t > samples;
+			size_t head        = 0;
+			size_t filled      = 0;
+			double energy_sum  = 0.0;
+			size_t samples_sum = 0;
+
+			void resize( size_t capacity );
+			void clear( );
+			void push( double block_energy, size_t block_samples );
+			bool is_full( ) const
+			{
+				return filled == energy.size( );
+			}
+			double get_mean_square( ) const
+			{
+				return ( samples_sum > 0 ) ? energy_sum / static_cast< double >( samples_sum ) : 0.0;
+			}
 		};
-		filter_state high_shelf_l_, high_shelf_r_;
-		filter_state high_pass_l_, high_pass_r_;
+		block_window momentary_;  // 400ms
+		block_window short_term_; // 3s
 
-		// loudness accumulators
-		std::vector< float > momentary_buffer_;  // 400ms blocks
-		std::vector< float > short_term_buffer_; // 3s blocks
-		double integrated_sum_   = 0.0;
-		size_t integrated_count_ = 0;
+		// 400ms gating blocks and 3s short-term values, one each every 100ms
+		loudness_histogram gating_blocks_;
+		loudness_histogram short_term_blocks_;
 
 		float momentary_lufs_  = -100.0f;
 		float short_term_lufs_ = -100.0f;
 		float integrated_lufs_ = -100.0f;
+		float loudness_range_  = 0.0f;
+
+		float max_momentary_lufs_  = -100.0f;
+		float max_short_term_lufs_ = -100.0f;
 
+		// K-weighted sum of squares per channel of the current sub-block, and
+		// the sub-block's index within the current second
 		size_t block_samples_ = 0;
-		double block_sum_l_   = 0.0;
-		double block_sum_r_   = 0.0;
+		std::vector< double > block_sum_;
+		int block_index_ = 0;
 
-		// K-weighting filter coefficients
+		void set_channels( int channels );
+		size_t get_block_size( int index ) const;
+		void finish_block( );
 		void compute_filter_coefficients( );
-		double apply_k_weighting( double sample, filter_state& hs, filter_state& hp, bool is_left );
 	};
 
 } // namespace pm
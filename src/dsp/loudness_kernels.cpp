@@ -0,0 +1,369 @@
+#include "loudness_kernels.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// analogue prototypes of the BS.1770 pre-filter (as fitted by libebur128
+	// to the 48 kHz table, they give the same response at any other rate)
+	static constexpr double k_shelf_frequency = 1681.974450955533;
+	static constexpr double k_shelf_gain_db   = 3.999843853973347;
+	static constexpr double k_shelf_q         = 0.7071752369554196;
+	static constexpr double k_shelf_vb_power  = 0.4996667741545416;
+
+	static constexpr double k_high_pass_frequency = 38.13547087602444;
+	static constexpr double k_high_pass_q         = 0.5003270373238773;
+
+	// delay line values below this are flushed. ~-600 dBFS, far under the
+	// float input's resolution, but well clear of the double denormal range
+	static constexpr double k_state_floor = 1e-30;
+
+	// frames between flushes. at the high pass pole radius (~0.995 at 48 kHz)
+	// state needs over 100k frames to decay from the floor into denormals
+	static constexpr size_t k_flush_frames = 4096;
+
+	k_weighting_coefficients make_k_weighting( int sample_rate )
+	{
+		const double pi   = 3.14159265358979323846;
+		const double rate = static_cast< double >( std::max( sample_rate, 1 ) );
+
+		k_weighting_coefficients c;
+
+		{
+			const double k  = std::tan( pi * k_shelf_frequency / rate );
+			const double vh = std::pow( 10.0, k_shelf_gain_db / 20.0 );
+			const double vb = std::pow( vh, k_shelf_vb_power );
+			const double a0 = 1.0 + k / k_shelf_q + k * k;
+
+			c.shelf.b0 = ( vh + vb * k / k_shelf_q + k * k ) / a0;
+			c.shelf.b1 = 2.0 * ( k * k - vh ) / a0;
+			c.shelf.b2 = ( vh - vb * k / k_shelf_q + k * k ) / a0;
+			c.shelf.a1 = 2.0 * ( k * k - 1.0 ) / a0;
+			c.shelf.a2 = ( 1.0 - k / k_shelf_q + k * k ) / a0;
+		}
+
+		{
+			const double k  = std::tan( pi * k_high_pass_frequency / rate );
+			const double a0 = 1.0 + k / k_high_pass_q + k * k;
+
+			// the recommendation leaves the numerator unnormalised, so the
+			// passband sits a hair above unity exactly as in its table
+			c.high_pass.b0 = 1.0;
+			c.high_pass.b1 = -2.0;
+			c.high_pass.b2 = 1.0;
+			c.high_pass.a1 = 2.0 * ( k * k - 1.0 ) / a0;
+			c.high_pass.a2 = ( 1.0 - k / k_high_pass_q + k * k ) / a0;
+		}
+
+		return c;
+	}
+
+	static inline double biquad_tick( const biquad_coefficients& c, double x, double& z1, double& z2 )
+	{
+		const double y = c.b0 * x + z1;
+		z1             = c.b1 * x - c.a1 * y + z2;
+		z2             = c.b2 * x - c.a2 * y;
+		return y;
+	}
+
+	// a kernel handles the channels [ first, first + lanes ) of every frame.
+	// line l of the state for channel ch is state[ l * channels + ch ]
+
+	static void k_weighting_lane( const sample_t* samples, size_t frames, int channels, int first, const k_weighting_coefficients& c, double* state,
+	                              double* sums )
+	{
+		const size_t n = static_cast< size_t >( channels );
+		double* z      = state + first;
+
+		double sum = 0.0;
+		for ( size_t i = 0; i < frames; ++i ) {
+			double y = biquad_tick( c.shelf, samples[ i * n + first ], z[ 0 ], z[ n ] );
+			y        = biquad_tick( c.high_pass, y, z[ n * 2 ], z[ n * 3 ] );
+			sum += y * y;
+		}
+		sums[ first ] += sum;
+	}
+
+	static void k_weighting_generic( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& c, double* state,
+	                                 double* sums )
+	{
+		for ( int ch = 0; ch < channels; ++ch ) {
+			k_weighting_lane( samples, frames, channels, ch, c, state, sums );
+		}
+	}
+
+#if defined( PM_SIMD_X86 )
+
+	static inline __m128d load_pair( const sample_t* p )
+	{
+		return _mm_cvtps_pd( _mm_castsi128_ps( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( p ) ) ) );
+	}
+
+	// two channels per vector, both move through the recursion together
+	static void k_weighting_pair_sse2( const sample_t* samples, size_t frames, int channels, int first, const k_weighting_coefficients& c,
+	                                   double* state, double* sums )
+	{
+		const size_t n = static_cast< size_t >( channels );
+		double* z      = state + first;
+
+		const __m128d sb0 = _mm_set1_pd( c.shelf.b0 );
+		const __m128d sb1 = _mm_set1_pd( c.shelf.b1 );
+		const __m128d sb2 = _mm_set1_pd( c.shelf.b2 );
+		const __m128d sa1 = _mm_set1_pd( c.shelf.a1 );
+		const __m128d sa2 = _mm_set1_pd( c.shelf.a2 );
+		const __m128d pb0 = _mm_set1_pd( c.high_pass.b0 );
+		const __m128d pb1 = _mm_set1_pd( c.high_pass.b1 );
+		const __m128d pb2 = _mm_set1_pd( c.high_pass.b2 );
+		const __m128d pa1 = _mm_set1_pd( c.high_pass.a1 );
+		const __m128d pa2 = _mm_set1_pd( c.high_pass.a2 );
+
+		__m128d s1  = _mm_loadu_pd( z );
+		__m128d s2  = _mm_loadu_pd( z + n );
+		__m128d p1  = _mm_loadu_pd( z + n * 2 );
+		__m128d p2  = _mm_loadu_pd( z + n * 3 );
+		__m128d acc = _mm_setzero_pd( );
+
+		for ( size_t i = 0; i < frames; ++i ) {
+			__m128d x = load_pair( samples + i * n + first );
+
+			__m128d y = _mm_add_pd( _mm_mul_pd( sb0, x ), s1 );
+			s1        = _mm_add_pd( _mm_sub_pd( _mm_mul_pd( sb1, x ), _mm_mul_pd( sa1, y ) ), s2 );
+			s2        = _mm_sub_pd( _mm_mul_pd( sb2, x ), _mm_mul_pd( sa2, y ) );
+
+			x  = y;
+			y  = _mm_add_pd( _mm_mul_pd( pb0, x ), p1 );
+			p1 = _mm_add_pd( _mm_sub_pd( _mm_mul_pd( pb1, x ), _mm_mul_pd( pa1, y ) ), p2 );
+			p2 = _mm_sub_pd( _mm_mul_pd( pb2, x ), _mm_mul_pd( pa2, y ) );
+
+			acc = _mm_add_pd( acc, _mm_mul_pd( y, y ) );
+		}
+
+		_mm_storeu_pd( z, s1 );
+		_mm_storeu_pd( z + n, s2 );
+		_mm_storeu_pd( z + n * 2, p1 );
+		_mm_storeu_pd( z + n * 3, p2 );
+		_mm_storeu_pd( sums + first, _mm_add_pd( _mm_loadu_pd( sums + first ), acc ) );
+	}
+
+	static void k_weighting_sse2( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& c, double* state,
+	                              double* sums )
+	{
+		int ch = 0;
+		for ( ; ch + 2 <= channels; ch += 2 ) {
+			k_weighting_pair_sse2( samples, frames, channels, ch, c, state, sums );
+		}
+		for ( ; ch < channels; ++ch ) {
+			k_weighting_lane( samples, frames, channels, ch, c, state, sums );
+		}
+	}
+
+	// same as the sse2 pair, fma shortens the recursive path to two ops per stage
+	PM_TARGET_AVX2 static void k_weighting_pair_fma( const sample_t* samples, size_t frames, int channels, int first, const k_weighting_coefficients& c,
+	                                                 double* state, double* sums )
+	{
+		const size_t n = static_cast< size_t >( channels );
+		double* z      = state + first;
+
+		const __m128d sb0 = _mm_set1_pd( c.shelf.b0 );
+		const __m128d sb1 = _mm_set1_pd( c.shelf.b1 );
+		const __m128d sb2 = _mm_set1_pd( c.shelf.b2 );
+		const __m128d sa1 = _mm_set1_pd( c.shelf.a1 );
+		const __m128d sa2 = _mm_set1_pd( c.shelf.a2 );
+		const __m128d pb0 = _mm_set1_pd( c.high_pass.b0 );
+		const __m128d pb1 = _mm_set1_pd( c.high_pass.b1 );
+		const __m128d pb2 = _mm_set1_pd( c.high_pass.b2 );
+		const __m128d pa1 = _mm_set1_pd( c.high_pass.a1 );
+		const __m128d pa2 = _mm_set1_pd( c.high_pass.a2 );
+
+		__m128d s1  = _mm_loadu_pd( z );
+		__m128d s2  = _mm_loadu_pd( z + n );
+		__m128d p1  = _mm_loadu_pd( z + n * 2 );
+		__m128d p2  = _mm_loadu_pd( z + n * 3 );
+		__m128d acc = _mm_setzero_pd( );
+
+		for ( size_t i = 0; i < frames; ++i ) {
+			__m128d x = load_pair( samples + i * n + first );
+
+			__m128d y = _mm_fmadd_pd( sb0, x, s1 );
+			s1        = _mm_fnmadd_pd( sa1, y, _mm_fmadd_pd( sb1, x, s2 ) );
+			s2        = _mm_fnmadd_pd( sa2, y, _mm_mul_pd( sb2, x ) );
+
+			x  = y;
+			y  = _mm_fmadd_pd( pb0, x, p1 );
+			p1 = _mm_fnmadd_pd( pa1, y, _mm_fmadd_pd( pb1, x, p2 ) );
+			p2 = _mm_fnmadd_pd( pa2, y, _mm_mul_pd( pb2, x ) );
+
+			acc = _mm_fmadd_pd( y, y, acc );
+		}
+
+		_mm_storeu_pd( z, s1 );
+		_mm_storeu_pd( z + n, s2 );
+		_mm_storeu_pd( z + n * 2, p1 );
+		_mm_storeu_pd( z + n * 3, p2 );
+		_mm_storeu_pd( sums + first, _mm_add_pd( _mm_loadu_pd( sums + first ), acc ) );
+	}
+
+	// four channels per vector, e.g. L R C LFE and the surrounds of 7.1
+	PM_TARGET_AVX2 static void k_weighting_quad_avx2( const sample_t* samples, size_t frames, int channels, int first, const k_weighting_coefficients& c,
+	                                                  double* state, double* sums )
+	{
+		const size_t n = static_cast< size_t >( channels );
+		double* z      = state + first;
+
+		const __m256d sb0 = _mm256_set1_pd( c.shelf.b0 );
+		const __m256d sb1 = _mm256_set1_pd( c.shelf.b1 );
+		const __m256d sb2 = _mm256_set1_pd( c.shelf.b2 );
+		const __m256d sa1 = _mm256_set1_pd( c.shelf.a1 );
+		const __m256d sa2 = _mm256_set1_pd( c.shelf.a2 );
+		const __m256d pb0 = _mm256_set1_pd( c.high_pass.b0 );
+		const __m256d pb1 = _mm256_set1_pd( c.high_pass.b1 );
+		const __m256d pb2 = _mm256_set1_pd( c.high_pass.b2 );
+		const __m256d pa1 = _mm256_set1_pd( c.high_pass.a1 );
+		const __m256d pa2 = _mm256_set1_pd( c.high_pass.a2 );
+
+		__m256d s1  = _mm256_loadu_pd( z );
+		__m256d s2  = _mm256_loadu_pd( z + n );
+		__m256d p1  = _mm256_loadu_pd( z + n * 2 );
+		__m256d p2  = _mm256_loadu_pd( z + n * 3 );
+		__m256d acc = _mm256_setzero_pd( );
+
+		for ( size_t i = 0; i < frames; ++i ) {
+			__m256d x = _mm256_cvtps_pd( _mm_loadu_ps( samples + i * n + first ) );
+
+			__m256d y = _mm256_fmadd_pd( sb0, x, s1 );
+			s1        = _mm256_fnmadd_pd( sa1, y, _mm256_fmadd_pd( sb1, x, s2 ) );
+			s2        = _mm256_fnmadd_pd( sa2, y, _mm256_mul_pd( sb2, x ) );
+
+			x  = y;
+			y  = _mm256_fmadd_pd( pb0, x, p1 );
+			p1 = _mm256_fnmadd_pd( pa1, y, _mm256_fmadd_pd( pb1, x, p2 ) );
+			p2 = _mm256_fnmadd_pd( pa2, y, _mm256_mul_pd( pb2, x ) );
+
+			acc = _mm256_fmadd_pd( y, y, acc );
+		}
+
+		_mm256_storeu_pd( z, s1 );
+		_mm256_storeu_pd( z + n, s2 );
+		_mm256_storeu_pd( z + n * 2, p1 );
+		_mm256_storeu_pd( z + n * 3, p2 );
+		_mm256_storeu_pd( sums + first, _mm256_add_pd( _mm256_loadu_pd( sums + first ), acc ) );
+	}
+
+	PM_TARGET_AVX2 static void k_weighting_avx2( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& c, double* state,
+	                                             double* sums )
+	{
+		int ch = 0;
+		for ( ; ch + 4 <= channels; ch += 4 ) {
+			k_weighting_quad_avx2( samples, frames, channels, ch, c, state, sums );
+		}
+		for ( ; ch + 2 <= channels; ch += 2 ) {
+			k_weighting_pair_fma( samples, frames, channels, ch, c, state, sums );
+		}
+		for ( ; ch < channels; ++ch ) {
+			k_weighting_lane( samples, frames, channels, ch, c, state, sums );
+		}
+	}
+
+#elif defined( PM_SIMD_NEON )
+
+	static void k_weighting_pair_neon( const sample_t* samples, size_t frames, int channels, int first, const k_weighting_coefficients& c,
+	                                   double* state, double* sums )
+	{
+		const size_t n = static_cast< size_t >( channels );
+		double* z      = state + first;
+
+		const float64x2_t sb0 = vdupq_n_f64( c.shelf.b0 );
+		const float64x2_t sb1 = vdupq_n_f64( c.shelf.b1 );
+		const float64x2_t sb2 = vdupq_n_f64( c.shelf.b2 );
+		const float64x2_t sa1 = vdupq_n_f64( c.shelf.a1 );
+		const float64x2_t sa2 = vdupq_n_f64( c.shelf.a2 );
+		const float64x2_t pb0 = vdupq_n_f64( c.high_pass.b0 );
+		const float64x2_t pb1 = vdupq_n_f64( c.high_pass.b1 );
+		const float64x2_t pb2 = vdupq_n_f64( c.high_pass.b2 );
+		const float64x2_t pa1 = vdupq_n_f64( c.high_pass.a1 );
+		const float64x2_t pa2 = vdupq_n_f64( c.high_pass.a2 );
+
+		float64x2_t s1  = vld1q_f64( z );
+		float64x2_t s2  = vld1q_f64( z + n );
+		float64x2_t p1  = vld1q_f64( z + n * 2 );
+		float64x2_t p2  = vld1q_f64( z + n * 3 );
+		float64x2_t acc = vdupq_n_f64( 0.0 );
+
+		for ( size_t i = 0; i < frames; ++i ) {
+			float64x2_t x = vcvt_f64_f32( vld1_f32( samples + i * n + first ) );
+
+			float64x2_t y = vfmaq_f64( s1, sb0, x );
+			s1            = vfmsq_f64( vfmaq_f64( s2, sb1, x ), sa1, y );
+			s2            = vfmsq_f64( vmulq_f64( sb2, x ), sa2, y );
+
+			x  = y;
+			y  = vfmaq_f64( p1, pb0, x );
+			p1 = vfmsq_f64( vfmaq_f64( p2, pb1, x ), pa1, y );
+			p2 = vfmsq_f64( vmulq_f64( pb2, x ), pa2, y );
+
+			acc = vfmaq_f64( acc, y, y );
+		}
+
+		vst1q_f64( z, s1 );
+		vst1q_f64( z + n, s2 );
+		vst1q_f64( z + n * 2, p1 );
+		vst1q_f64( z + n * 3, p2 );
+		vst1q_f64( sums + first, vaddq_f64( vld1q_f64( sums + first ), acc ) );
+	}
+
+	static void k_weighting_neon( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& c, double* state,
+	                              double* sums )
+	{
+		int ch = 0;
+		for ( ; ch + 2 <= channels; ch += 2 ) {
+			k_weighting_pair_neon( samples, frames, channels, ch, c, state, sums );
+		}
+		for ( ; ch < channels; ++ch ) {
+			k_weighting_lane( samples, frames, channels, ch, c, state, sums );
+		}
+	}
+
+#endif
+
+	using k_weighting_fn = void ( * )( const sample_t*, size_t, int, const k_weighting_coefficients&, double*, double* );
+
+	static k_weighting_fn resolve_k_weighting( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return k_weighting_avx2;
+		case simd::isa::sse2:
+			return k_weighting_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return k_weighting_neon;
+#endif
+		default:
+			return k_weighting_generic;
+		}
+	}
+
+	void k_weighting( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& coefficients, double* state,
+	                  double* sums )
+	{
+		static const k_weighting_fn fn = resolve_k_weighting( );
+		if ( channels < 1 )
+			return;
+
+		const size_t lines = k_weighting_state_lines * static_cast< size_t >( channels );
+		for ( size_t offset = 0; offset < frames; offset += k_flush_frames ) {
+			const size_t count = std::min( k_flush_frames, frames - offset );
+			fn( samples + offset * channels, count, channels, coefficients, state, sums );
+
+			for ( size_t i = 0; i < lines; ++i ) {
+				if ( std::fabs( state[ i ] ) < k_state_floor ) {
+					state[ i ] = 0.0;
+				}
+			}
+		}
+	}
+
+} // namespace pm
@@ -0,0 +1,43 @@
+#pragma once
+
+// BS.1770 K-weighting pre-filter and its vectorised biquad kernels
+
+#include "../common/types.h"
+
+namespace pm
+{
+
+	// normalised so a0 = 1, transposed direct form II:
+	//   y = b0 x + z1,  z1 = b1 x - a1 y + z2,  z2 = b2 x - a2 y
+	struct biquad_coefficients {
+		double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+		double a1 = 0.0, a2 = 0.0;
+	};
+
+	// stage 1 models the acoustic effect of the head (high shelf, ~+4 dB
+	// above ~1.7 kHz), stage 2 is the RLB high pass (~38 Hz)
+	struct k_weighting_coefficients {
+		biquad_coefficients shelf;
+		biquad_coefficients high_pass;
+	};
+
+	// BS.1770-4 pre-filter for any sample rate. the analogue prototypes are
+	// mapped with a prewarped bilinear transform, at 48 kHz this reproduces
+	// the coefficient table printed in the recommendation
+	k_weighting_coefficients make_k_weighting( int sample_rate );
+
+	// delay line values per channel: four lines of channels doubles each,
+	// shelf z1, shelf z2, high pass z1, high pass z2
+	constexpr size_t k_weighting_state_lines = 4;
+
+	// runs interleaved samples of any channel count through both stages and
+	// adds each channel's squared output to sums[ channel ]. channels sit in
+	// the lanes of double vectors (4 per AVX2 register, 2 for SSE2 / NEON)
+	// and the recursion advances a frame at a time, so cost grows linearly
+	// with the channel count and stereo costs the same as mono. state that
+	// has decayed below the audible floor is flushed to zero every few
+	// thousand frames, so long silences never reach denormals
+	void k_weighting( const sample_t* samples, size_t frames, int channels, const k_weighting_coefficients& coefficients, double* state,
+	                  double* sums );
+
+} // namespace pm
@@ -0,0 +1,198 @@
+#include "multires_analyzer.h"
+#include "halfband_decimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// frames handled per inner iteration, bounds the scratch buffers
+	static constexpr size_t k_block_frames = 512;
+
+	struct multires_analyzer::stage {
+		stft analysis;
+		halfband_decimator decimator;
+		std::vector< sample_t > output;
+
+		stage( size_t fft_size, stft_input input, int channels )
+		    : analysis( fft_size, fft_size / 2, input ), decimator( channels ), output( k_block_frames * channels )
+		{
+			analysis.get_processor( ).set_cumulative_power( true );
+			analysis.get_processor( ).set_power_smoothing( true );
+		}
+	};
+
+	multires_analyzer::multires_analyzer( size_t fft_size, size_t stage_count, stft_input input ) : input_( input )
+	{
+		const int channels = ( input == stft_input::stereo ) ? 2 : 1;
+
+		stage_count = std::max< size_t >( stage_count, 1 );
+		for ( size_t i = 0; i < stage_count; ++i ) {
+			stages_.push_back( std::make_unique< stage >( fft_size, input, channels ) );
+		}
+
+		stages_.front( )->analysis.set_frame_callback( [ this ]( const fft_processor& ) {
+			if ( callback_ ) {
+				callback_( *this );
+			}
+		} );
+
+		set_sample_rate( sample_rate_ );
+	}
+
+	multires_analyzer::~multires_analyzer( ) = default;
+
+	void multires_analyzer::set_sample_rate( int sample_rate )
+	{
+		sample_rate_ = sample_rate;
+		for ( size_t i = 0; i < stages_.size( ); ++i ) {
+			stages_[ i ]->analysis.set_sample_rate( static_cast< int >( std::lround( sample_rate / std::ldexp( 1.0, static_cast< int >( i ) ) ) ) );
+		}
+		update_smoothing( );
+		reset( );
+	}
+
+	void multires_analyzer::set_fft_size( size_t size )
+	{
+		for ( auto& s : stages_ ) {
+			s->analysis.set_fft_size( size );
+			s->analysis.set_hop_size( size / 2 );
+		}
+
+		// frame rates follow the hop
+		update_smoothing( );
+		reset( );
+	}
+
+	size_t multires_analyzer::get_fft_size( ) const
+	{
+		return stages_.front( )->analysis.get_fft_size( );
+	}
+
+	void multires_analyzer::set_time_constant( float time_ms )
+	{
+		time_constant_ = time_ms;
+		update_smoothing( );
+	}
+
+	void multires_analyzer::update_smoothing( )
+	{
+		const float tau = std::max( time_constant_ * 0.001f, 1e-6f );
+		for ( auto& s : stages_ ) {
+			float frame_period = 1.0f / s->analysis.get_frame_rate( );
+			s->analysis.get_processor( ).set_smoothing( std::exp( -frame_period / tau ) );
+		}
+	}
+
+	void multires_analyzer::reset( )
+	{
+		for ( auto& s : stages_ ) {
+			s->analysis.reset( );
+			s->decimator.reset( );
+		}
+	}
+
+	const fft_processor& multires_analyzer::get_stage( size_t index ) const
+	{
+		return stages_[ std::min( index, stages_.size( ) - 1 ) ]->analysis.get_processor( );
+	}
+
+	size_t multires_analyzer::push( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return 0;
+
+		const int stage_channels = ( input_ == stft_input::stereo ) ? 2 : 1;
+		size_t frames            = 0;
+
+		sample_t block[ k_block_frames * 2 ];
+
+		for ( size_t offset = 0; offset < frame_count; offset += k_block_frames ) {
+			size_t count = std::min( k_block_frames, frame_count - offset );
+
+			// bring the input to the stage layout (stereo pair or mono downmix)
+			for ( size_t i = 0; i < count; ++i ) {
+				const sample_t* src = samples + ( offset + i ) * channels;
+				float l             = src[ 0 ];
+				float r             = ( channels >= 2 ) ? src[ 1 ] : l;
+
+				if ( stage_channels == 2 ) {
+					block[ i * 2 ]     = l;
+					block[ i * 2 + 1 ] = r;
+				} else {
+					block[ i ] = ( l + r ) * 0.5f;
+				}
+			}
+
+			const sample_t* stage_input = block;
+			size_t stage_count          = count;
+
+			for ( size_t i = 0; i < stages_.size( ) && stage_count > 0; ++i ) {
+				stage& s     = *stages_[ i ];
+				size_t added = s.analysis.push( stage_input, stage_count, stage_channels );
+				if ( i == 0 ) {
+					frames += added;
+				}
+
+				if ( i + 1 < stages_.size( ) ) {
+					stage_count = s.decimator.process( stage_input, stage_count, s.output.data( ) );
+					stage_input = s.output.data( );
+				}
+			}
+		}
+
+		return frames;
+	}
+
+	float multires_analyzer::get_stage_limit( size_t index ) const
+	{
+		const float rate = static_cast< float >( sample_rate_ ) / static_cast< float >( 1u << index );
+		return ( index == 0 ) ? rate * 0.5f : rate * 0.25f;
+	}
+
+	float multires_analyzer::get_band_power( float freq_start, float freq_end, fft_channel channel ) const
+	{
+		// finest stage whose clean range still reaches freq_end
+		size_t index = 0;
+		for ( size_t i = stages_.size( ); i-- > 0; ) {
+			if ( freq_end <= get_stage_limit( i ) ) {
+				index = i;
+				break;
+			}
+		}
+
+		// stage processors run at their own (decimated) rate, so Hz map directly
+		return stages_[ index ]->analysis.get_processor( ).get_band_power( freq_start, freq_end, channel );
+	}
+
+	float multires_analyzer::get_band_magnitude_db( float freq_start, float freq_end, fft_channel channel ) const
+	{
+		float power = get_band_power( freq_start, freq_end, channel );
+		return ( power > 1e-20f ) ? 10.0f * std::log10( power ) : -100.0f;
+	}
+
+	void multires_analyzer::get_peak( fft_channel channel, float& frequency, float& db ) const
+	{
+		frequency = 0.0f;
+		db        = -100.0f;
+
+		for ( size_t i = 0; i < stages_.size( ); ++i ) {
+			const fft_processor& fft = stages_[ i ]->analysis.get_processor( );
+			const auto& mags_db      = fft.get_magnitudes_db( channel );
+			float bin_width          = static_cast< float >( sample_rate_ ) / static_cast< float >( 1u << i ) / ( fft.get_bin_count( ) * 2.0f );
+
+			// this stage's own range: [next stage limit, own limit)
+			float low        = ( i + 1 < stages_.size( ) ) ? get_stage_limit( i + 1 ) : 0.0f;
+			size_t bin_start = std::max< size_t >( 1, static_cast< size_t >( low / bin_width ) );
+			size_t bin_end   = std::min( mags_db.size( ), static_cast< size_t >( get_stage_limit( i ) / bin_width ) );
+
+			for ( size_t b = bin_start; b < bin_end; ++b ) {
+				if ( mags_db[ b ] > db ) {
+					db        = mags_db[ b ];
+					frequency = static_cast< float >( b ) * bin_width;
+				}
+			}
+		}
+	}
+
+} // namespace pm
@@ -0,0 +1,88 @@
+#pragma once
+
+// multi-resolution spectrum analyser (octave-decimated FFT stages)
+
+#include "stft.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace pm
+{
+
+	// analysis feeding the spectrum and spectrogram views
+	enum class spectrum_source {
+		fft,             // single STFT at the configured size
+		multi_resolution // octave-decimated stages, finer bins at the low end
+	};
+
+	class multires_analyzer;
+
+	// called after every frame of the full-rate stage
+	using multires_frame_callback_t = std::function< void( const multires_analyzer& analyzer ) >;
+
+	// runs the same small FFT on the input and on successively half-band
+	// decimated copies of it. stage k sees sample_rate / 2^k, so its bins are
+	// 2^k times narrower. stage 0 answers everything above sample_rate / 8,
+	// stage k > 0 answers [rate_k / 8, rate_k / 4) and the last stage also
+	// everything below. with the defaults (1024 points, 5 stages) that is
+	// 46.9 Hz bins above 6 kHz down to 2.9 Hz bins below 750 Hz at 48 kHz, for
+	// roughly twice the cost of the single 1024-point stream
+	class multires_analyzer
+	{
+	public:
+		explicit multires_analyzer( size_t fft_size = k_fft_size_1024, size_t stage_count = 5, stft_input input = stft_input::stereo );
+		~multires_analyzer( );
+
+		// push interleaved samples, returns the number of full-rate frames emitted
+		size_t push( const sample_t* samples, size_t frame_count, int channels );
+		void reset( );
+
+		// mean linear power over [freq_start, freq_end), read from the finest
+		// stage that still covers freq_end without aliasing
+		float get_band_power( float freq_start, float freq_end, fft_channel channel = fft_channel::left ) const;
+		float get_band_magnitude_db( float freq_start, float freq_end, fft_channel channel = fft_channel::left ) const;
+
+		// loudest bin across all stages, each stage searched over its own range
+		void get_peak( fft_channel channel, float& frequency, float& db ) const;
+
+		// FFT size of every stage, hops stay at half a frame. resets
+		void set_fft_size( size_t size );
+		size_t get_fft_size( ) const;
+
+		void set_sample_rate( int sample_rate );
+		int get_sample_rate( ) const
+		{
+			return sample_rate_;
+		}
+		// exponential power smoothing with a real-time constant, the same
+		// ballistics as spectral_averager. stages run at very different frame
+		// rates, so each gets its own per-frame coefficient
+		void set_time_constant( float time_ms );
+
+		size_t get_stage_count( ) const
+		{
+			return stages_.size( );
+		}
+		const fft_processor& get_stage( size_t index ) const;
+
+		void set_frame_callback( multires_frame_callback_t callback )
+		{
+			callback_ = std::move( callback );
+		}
+
+	private:
+		struct stage;
+
+		stft_input input_;
+		int sample_rate_     = k_default_sample_rate;
+		float time_constant_ = 100.0f;
+		std::vector< std::unique_ptr< stage > > stages_;
+		multires_frame_callback_t callback_;
+
+		// highest frequency stage `index` is responsible for
+		float get_stage_limit( size_t index ) const;
+		void update_smoothing( );
+	};
+
+} // namespace pm
@@ -0,0 +1,225 @@
+#include "pitch_detector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// a key maximum is picked when it reaches this fraction of the highest one.
+	// McLeod & Wyvill use 0.8 - 1.0, lower favours short periods
+	static constexpr float k_pick_ratio = 0.9f;
+
+	// octave hysteresis against the previous frame. a sub-harmonic lobe always
+	// exists at the old period after a genuine jump up, so that direction only
+	// holds while the old lobe is clearly the stronger one. going down, the
+	// old (shorter) lobe already missed the pick ratio, so it is kept unless
+	// it fell well behind
+	static constexpr float k_octave_up_margin   = 0.05f;
+	static constexpr float k_octave_down_margin = 0.1f;
+
+	// relative lag tolerance when matching periods across frames
+	static constexpr float k_period_tolerance = 0.03f;
+
+	pitch_detector::pitch_detector( size_t max_window ) : max_window_( max_window )
+	{
+		size_t padded = 1;
+		while ( padded < max_window * 2 ) {
+			padded <<= 1;
+		}
+
+		frame_.reserve( max_window );
+		padded_.reserve( padded );
+		spectrum_.reserve( padded + 2 );
+		scratch_.reserve( padded );
+		nsdf_.reserve( max_window / 2 + 1 );
+		maxima_.reserve( max_window / 2 );
+	}
+
+	void pitch_detector::set_range( float min_hz, float max_hz )
+	{
+		min_hz_ = std::max( min_hz, 1.0f );
+		max_hz_ = std::max( max_hz, min_hz_ );
+	}
+
+	void pitch_detector::reset( )
+	{
+		estimate_    = { };
+		last_period_ = 0.0f;
+	}
+
+	const pitch_detector::key_maximum* pitch_detector::find_lobe_near( float lag ) const
+	{
+		for ( const auto& maximum : maxima_ ) {
+			if ( std::fabs( maximum.lag - lag ) <= lag * k_period_tolerance )
+				return &maximum;
+		}
+		return nullptr;
+	}
+
+	const pitch_estimate& pitch_detector::process( const sample_t* samples, size_t count )
+	{
+		estimate_ = { };
+
+		const size_t n = std::min( count, max_window_ );
+		if ( n < 8 )
+			return estimate_;
+
+		const sample_t* x = samples + ( count - n );
+
+		// level gate, on the mean-removed signal
+		double mean = 0.0;
+		for ( size_t i = 0; i < n; ++i ) {
+			mean += x[ i ];
+		}
+		mean /= static_cast< double >( n );
+
+		size_t padded = 1;
+		while ( padded < n * 2 ) {
+			padded <<= 1;
+		}
+
+		frame_.resize( n );
+		padded_.assign( padded, 0.0f );
+		double energy = 0.0;
+		for ( size_t i = 0; i < n; ++i ) {
+			const float v = static_cast< float >( x[ i ] - mean );
+			frame_[ i ]   = v;
+			padded_[ i ]  = v;
+			energy += static_cast< double >( v ) * v;
+		}
+
+		const double rms_db = 10.0 * std::log10( energy / static_cast< double >( n ) + 1e-20 );
+		if ( rms_db < silence_db_ ) {
+			last_period_ = 0.0f;
+			return estimate_;
+		}
+
+		if ( !plan_ || plan_->get_size( ) != padded ) {
+			plan_ = fft_plan_cache::instance( ).get_plan( padded );
+		}
+		spectrum_.resize( padded + 2 );
+		scratch_.resize( padded );
+
+		// r( t ) = IFFT( |X|^2 ). the power spectrum is real and even, so the
+		// forward real transform gives padded * r( t ) in its real parts
+		plan_->forward_real( padded_.data( ), spectrum_.data( ), scratch_.data( ) );
+
+		const size_t half = padded / 2;
+		for ( size_t k = 0; k <= half; ++k ) {
+			const float re = spectrum_[ k * 2 ];
+			const float im = spectrum_[ k * 2 + 1 ];
+			padded_[ k ]   = re * re + im * im;
+			if ( k > 0 && k < half ) {
+				padded_[ padded - k ] = padded_[ k ];
+			}
+		}
+
+		plan_->forward_real( padded_.data( ), spectrum_.data( ), scratch_.data( ) );
+
+		// lag range: at least two periods in the window
+		const float rate     = static_cast< float >( sample_rate_ );
+		const size_t max_lag = std::min( n / 2, static_cast< size_t >( rate / min_hz_ ) );
+		const size_t min_lag = std::max< size_t >( 2, static_cast< size_t >( rate / max_hz_ ) );
+		if ( max_lag <= min_lag )
+			return estimate_;
+
+		// m( t ) shrinks by the two samples that leave the overlap each lag
+		nsdf_.assign( max_lag + 2, 0.0f );
+		double m = 2.0 * energy;
+		for ( size_t t = 0; t < nsdf_.size( ); ++t ) {
+			if ( t > 0 ) {
+				const double a = frame_[ t - 1 ];
+				const double b = frame_[ n - t ];
+				m -= a * a + b * b;
+			}
+			const double r = static_cast< double >( spectrum_[ t * 2 ] ) / static_cast< double >( padded );
+			nsdf_[ t ]     = ( m > 1e-12 ) ? static_cast< float >( 2.0 * r / m ) : 0.0f;
+		}
+
+		// highest point of every positive lobe after the zero-lag one
+		maxima_.clear( );
+		size_t t = 1;
+		while ( t < nsdf_.size( ) && nsdf_[ t ] > 0.0f ) {
+			t++;
+		}
+
+		bool in_lobe = false;
+		size_t best  = 0;
+		for ( ; t + 1 < nsdf_.size( ); ++t ) {
+			if ( nsdf_[ t ] > 0.0f ) {
+				if ( !in_lobe || nsdf_[ t ] > nsdf_[ best ] ) {
+					best = t;
+				}
+				in_lobe = true;
+			}
+
+			const bool lobe_ends = in_lobe && ( nsdf_[ t + 1 ] <= 0.0f || t + 2 == nsdf_.size( ) );
+			if ( !lobe_ends )
+				continue;
+
+			in_lobe = false;
+			if ( best < min_lag || best > max_lag )
+				continue;
+
+			// parabola through the peak and its neighbours
+			const float a = nsdf_[ best - 1 ];
+			const float b = nsdf_[ best ];
+			const float c = nsdf_[ best + 1 ];
+			const float d = a - 2.0f * b + c;
+
+			key_maximum maximum = { static_cast< float >( best ), b };
+			if ( d < 0.0f ) {
+				const float offset = 0.5f * ( a - c ) / d;
+				maximum.lag += offset;
+				maximum.value = b - 0.25f * ( a - c ) * offset;
+			}
+			maxima_.push_back( maximum );
+		}
+
+		if ( maxima_.empty( ) ) {
+			last_period_ = 0.0f;
+			return estimate_;
+		}
+
+		float highest = 0.0f;
+		for ( const auto& maximum : maxima_ ) {
+			highest = std::max( highest, maximum.value );
+		}
+
+		key_maximum chosen = maxima_.front( );
+		for ( const auto& maximum : maxima_ ) {
+			if ( maximum.value >= highest * k_pick_ratio ) {
+				chosen = maximum;
+				break;
+			}
+		}
+
+		// keep the previous octave unless the new one is clearly better
+		if ( last_period_ > 0.0f ) {
+			const float octaves = std::fabs( std::log2( chosen.lag / last_period_ ) );
+			if ( std::fabs( octaves - 1.0f ) < 0.05f || std::fabs( octaves - 2.0f ) < 0.05f ) {
+				const key_maximum* previous = find_lobe_near( last_period_ );
+				if ( previous ) {
+					const bool up   = chosen.lag < last_period_;
+					const bool hold = up ? previous->value > chosen.value + k_octave_up_margin
+					                     : previous->value >= chosen.value - k_octave_down_margin;
+					if ( hold ) {
+						chosen = *previous;
+					}
+				}
+			}
+		}
+
+		estimate_.confidence = std::clamp( chosen.value, 0.0f, 1.0f );
+		estimate_.voiced     = estimate_.confidence >= min_confidence_;
+		if ( estimate_.voiced ) {
+			estimate_.frequency = rate / chosen.lag;
+			last_period_        = chosen.lag;
+		} else {
+			last_period_ = 0.0f;
+		}
+
+		return estimate_;
+	}
+
+} // namespace pm
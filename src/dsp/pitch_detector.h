@@ -0,0 +1,87 @@
+#pragma once
+
+// monophonic pitch estimation (McLeod pitch method, FFT autocorrelation)
+
+#include "fft_plan_cache.h"
+#include <memory>
+#include <vector>
+
+namespace pm
+{
+
+	struct pitch_estimate {
+		float frequency  = 0.0f; // Hz, 0 when unvoiced
+		float confidence = 0.0f; // NSDF clarity of the chosen peak, 0..1
+		bool voiced      = false;
+	};
+
+	// normalised square difference function
+	//   n( t ) = 2 r( t ) / m( t ),  m( t ) = sum x_j^2 + x_{j+t}^2
+	// with r( t ) from two real FFTs of the zero-padded frame (O(N log N), no
+	// per-lag loop) and m( t ) from a running sum. the period is the first
+	// positive-lobe maximum within k_pick_ratio of the highest one, refined by
+	// a parabola. octave errors are suppressed twice: the ratio rule rejects
+	// sub-harmonics within a frame, and across frames a jump of an octave is
+	// only accepted when the lobe at the previous period has clearly lost.
+	// meant to be driven once per STFT frame with that frame's samples
+	class pitch_detector
+	{
+	public:
+		explicit pitch_detector( size_t max_window = k_fft_size_4096 );
+
+		// analyse the newest min( count, max_window ) samples
+		const pitch_estimate& process( const sample_t* samples, size_t count );
+		void reset( );
+
+		void set_sample_rate( int sample_rate )
+		{
+			sample_rate_ = sample_rate;
+		}
+		// search range in Hz, the low end is also capped at two periods per window
+		void set_range( float min_hz, float max_hz );
+
+		// frames below this clarity or level are reported unvoiced
+		void set_min_confidence( float confidence )
+		{
+			min_confidence_ = confidence;
+		}
+		void set_silence_db( float db )
+		{
+			silence_db_ = db;
+		}
+
+		const pitch_estimate& get_estimate( ) const
+		{
+			return estimate_;
+		}
+
+	private:
+		size_t max_window_;
+		int sample_rate_      = k_default_sample_rate;
+		float min_hz_         = 40.0f;
+		float max_hz_         = 2000.0f;
+		float min_confidence_ = 0.6f;
+		float silence_db_     = -60.0f;
+
+		// last voiced period in samples, drives the octave hysteresis
+		float last_period_ = 0.0f;
+
+		pitch_estimate estimate_;
+
+		std::shared_ptr< const fft_plan > plan_;
+		std::vector< float > frame_; // mean removed
+		std::vector< float > padded_;
+		std::vector< float > spectrum_;
+		std::vector< float > scratch_;
+		std::vector< float > nsdf_;
+
+		struct key_maximum {
+			float lag;
+			float value;
+		};
+		std::vector< key_maximum > maxima_;
+
+		const key_maximum* find_lobe_near( float lag ) const;
+	};
+
+} // namespace pm
@@ -0,0 +1,67 @@
+#include "simd.h"
+
+#if defined( PM_SIMD_X86 ) && defined( _MSC_VER )
+#	include <intrin.h>
+#endif
+
+namespace pm::simd
+{
+
+	static isa detect_isa( )
+	{
+#if defined( PM_SIMD_X86 )
+#	if defined( _MSC_VER )
+		int info[ 4 ] = { };
+		__cpuid( info, 0 );
+		const int max_leaf = info[ 0 ];
+
+		__cpuid( info, 1 );
+		const bool has_fma     = ( info[ 2 ] & ( 1 << 12 ) ) != 0;
+		const bool has_osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+
+		bool has_avx2 = false;
+		if ( max_leaf >= 7 ) {
+			__cpuidex( info, 7, 0 );
+			has_avx2 = ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+		}
+
+		// the OS has to save the YMM registers as well
+		const bool os_ymm = has_osxsave && ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+
+		if ( has_avx2 && has_fma && os_ymm )
+			return isa::avx2;
+#	else
+		__builtin_cpu_init( );
+		if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+			return isa::avx2;
+#	endif
+		return isa::sse2;
+#elif defined( PM_SIMD_NEON )
+		return isa::neon;
+#else
+		return isa::scalar;
+#endif
+	}
+
+	isa get_isa( )
+	{
+		static const isa detected = detect_isa( );
+		return detected;
+	}
+
+	const char* get_isa_name( isa value )
+	{
+		switch ( value ) {
+		case isa::scalar:
+			return "scalar";
+		case isa::sse2:
+			return "SSE2";
+		case isa::avx2:
+			return "AVX2";
+		case isa::neon:
+			return "NEON";
+		}
+		return "unknown";
+	}
+
+} // namespace pm::simd
@@ -0,0 +1,35 @@
+#pragma once
+
+// SIMD target selection and runtime CPU feature detection
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#	define PM_SIMD_X86 1
+#	include <immintrin.h>
+#elif defined( _M_ARM64 ) || defined( __aarch64__ )
+#	define PM_SIMD_NEON 1
+#	include <arm_neon.h>
+#endif
+
+// MSVC compiles AVX2 intrinsics without extra flags, GCC/Clang need the
+// target enabled per function so the rest of the binary stays baseline
+#if defined( PM_SIMD_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#	define PM_TARGET_AVX2 __attribute__( ( target( "avx2,fma" ) ) )
+#else
+#	define PM_TARGET_AVX2
+#endif
+
+namespace pm::simd
+{
+
+	enum class isa {
+		scalar,
+		sse2, // x86-64 baseline
+		avx2, // avx2 + fma
+		neon  // aarch64 baseline
+	};
+
+	// best instruction set supported by the host (detected once)
+	isa get_isa( );
+	const char* get_isa_name( isa value );
+
+} // namespace pm::simd
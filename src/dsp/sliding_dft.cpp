@@ -0,0 +1,266 @@
+#include "sliding_dft.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+namespace pm
+{
+
+	// samples handed to the kernel per call, bounds the stack scratch
+	static constexpr size_t k_block_frames = 256;
+
+	// bins are padded so every kernel runs whole vectors
+	static constexpr size_t k_bin_alignment = 8;
+
+	// per-sample damping. keeps rounding error from accumulating forever and
+	// tapers a 1 s window by ~5% at the oldest sample
+	static constexpr double k_damping = 1.0 - 1e-6;
+
+	struct sliding_dft_args {
+		const float* input;
+		const float* delayed; // x[n - N] for every input sample
+		size_t count;
+		size_t bins; // multiple of k_bin_alignment
+		const float* rotate_re;
+		const float* rotate_im;
+		const float* comb_re;
+		const float* comb_im;
+		float* state_re;
+		float* state_im;
+	};
+
+	// each group of bins keeps its state in registers for the whole block
+
+	static void sliding_dft_generic( const sliding_dft_args& a )
+	{
+		for ( size_t b = 0; b < a.bins; ++b ) {
+			const float rr = a.rotate_re[ b ], ri = a.rotate_im[ b ];
+			const float cr = a.comb_re[ b ], ci = a.comb_im[ b ];
+			float yr = a.state_re[ b ], yi = a.state_im[ b ];
+
+			for ( size_t i = 0; i < a.count; ++i ) {
+				const float x  = a.input[ i ];
+				const float xo = a.delayed[ i ];
+				const float nr = x - cr * xo + rr * yr - ri * yi;
+				const float ni = -ci * xo + rr * yi + ri * yr;
+				yr             = nr;
+				yi             = ni;
+			}
+
+			a.state_re[ b ] = yr;
+			a.state_im[ b ] = yi;
+		}
+	}
+
+#if defined( PM_SIMD_X86 )
+
+	static void sliding_dft_sse2( const sliding_dft_args& a )
+	{
+		for ( size_t b = 0; b < a.bins; b += 4 ) {
+			const __m128 rr = _mm_loadu_ps( a.rotate_re + b );
+			const __m128 ri = _mm_loadu_ps( a.rotate_im + b );
+			const __m128 cr = _mm_loadu_ps( a.comb_re + b );
+			const __m128 ci = _mm_loadu_ps( a.comb_im + b );
+			__m128 yr       = _mm_loadu_ps( a.state_re + b );
+			__m128 yi       = _mm_loadu_ps( a.state_im + b );
+
+			for ( size_t i = 0; i < a.count; ++i ) {
+				const __m128 x  = _mm_set1_ps( a.input[ i ] );
+				const __m128 xo = _mm_set1_ps( a.delayed[ i ] );
+
+				__m128 nr = _mm_sub_ps( x, _mm_mul_ps( cr, xo ) );
+				nr        = _mm_add_ps( nr, _mm_sub_ps( _mm_mul_ps( rr, yr ), _mm_mul_ps( ri, yi ) ) );
+				__m128 ni = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( rr, yi ), _mm_mul_ps( ri, yr ) ), _mm_mul_ps( ci, xo ) );
+				yr        = nr;
+				yi        = ni;
+			}
+
+			_mm_storeu_ps( a.state_re + b, yr );
+			_mm_storeu_ps( a.state_im + b, yi );
+		}
+	}
+
+	PM_TARGET_AVX2 static void sliding_dft_avx2( const sliding_dft_args& a )
+	{
+		for ( size_t b = 0; b < a.bins; b += 8 ) {
+			const __m256 rr = _mm256_loadu_ps( a.rotate_re + b );
+			const __m256 ri = _mm256_loadu_ps( a.rotate_im + b );
+			const __m256 cr = _mm256_loadu_ps( a.comb_re + b );
+			const __m256 ci = _mm256_loadu_ps( a.comb_im + b );
+			__m256 yr       = _mm256_loadu_ps( a.state_re + b );
+			__m256 yi       = _mm256_loadu_ps( a.state_im + b );
+
+			for ( size_t i = 0; i < a.count; ++i ) {
+				const __m256 x  = _mm256_set1_ps( a.input[ i ] );
+				const __m256 xo = _mm256_set1_ps( a.delayed[ i ] );
+
+				__m256 nr = _mm256_fmadd_ps( rr, yr, _mm256_fnmadd_ps( ri, yi, _mm256_fnmadd_ps( cr, xo, x ) ) );
+				__m256 ni = _mm256_fmadd_ps( rr, yi, _mm256_fnmadd_ps( ci, xo, _mm256_mul_ps( ri, yr ) ) );
+				yr        = nr;
+				yi        = ni;
+			}
+
+			_mm256_storeu_ps( a.state_re + b, yr );
+			_mm256_storeu_ps( a.state_im + b, yi );
+		}
+	}
+
+#elif defined( PM_SIMD_NEON )
+
+	static void sliding_dft_neon( const sliding_dft_args& a )
+	{
+		for ( size_t b = 0; b < a.bins; b += 4 ) {
+			const float32x4_t rr = vld1q_f32( a.rotate_re + b );
+			const float32x4_t ri = vld1q_f32( a.rotate_im + b );
+			const float32x4_t cr = vld1q_f32( a.comb_re + b );
+			const float32x4_t ci = vld1q_f32( a.comb_im + b );
+			float32x4_t yr       = vld1q_f32( a.state_re + b );
+			float32x4_t yi       = vld1q_f32( a.state_im + b );
+
+			for ( size_t i = 0; i < a.count; ++i ) {
+				const float32x4_t x  = vdupq_n_f32( a.input[ i ] );
+				const float32x4_t xo = vdupq_n_f32( a.delayed[ i ] );
+
+				float32x4_t nr = vfmaq_f32( vfmsq_f32( vfmsq_f32( x, cr, xo ), ri, yi ), rr, yr );
+				float32x4_t ni = vfmaq_f32( vfmsq_f32( vmulq_f32( ri, yr ), ci, xo ), rr, yi );
+				yr             = nr;
+				yi             = ni;
+			}
+
+			vst1q_f32( a.state_re + b, yr );
+			vst1q_f32( a.state_im + b, yi );
+		}
+	}
+
+#endif
+
+	using sliding_dft_fn = void ( * )( const sliding_dft_args& );
+
+	static sliding_dft_fn resolve_sliding_dft( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return sliding_dft_avx2;
+		case simd::isa::sse2:
+			return sliding_dft_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return sliding_dft_neon;
+#endif
+		default:
+			return sliding_dft_generic;
+		}
+	}
+
+	sliding_dft_bank::sliding_dft_bank( size_t window_length )
+	{
+		set_window_length( window_length );
+	}
+
+	void sliding_dft_bank::set_frequencies( const std::vector< float >& frequencies )
+	{
+		frequencies_ = frequencies;
+		update_coefficients( );
+	}
+
+	void sliding_dft_bank::set_window_length( size_t samples )
+	{
+		window_length_ = std::max< size_t >( samples, 1 );
+		update_coefficients( );
+	}
+
+	void sliding_dft_bank::set_sample_rate( int sample_rate )
+	{
+		sample_rate_ = sample_rate;
+		update_coefficients( );
+	}
+
+	void sliding_dft_bank::update_coefficients( )
+	{
+		const size_t padded = ( frequencies_.size( ) + k_bin_alignment - 1 ) / k_bin_alignment * k_bin_alignment;
+		const double pi     = 3.14159265358979323846;
+
+		// padding bins get zero coefficients and just echo the input
+		rotate_re_.assign( padded, 0.0f );
+		rotate_im_.assign( padded, 0.0f );
+		comb_re_.assign( padded, 0.0f );
+		comb_im_.assign( padded, 0.0f );
+
+		for ( size_t i = 0; i < frequencies_.size( ); ++i ) {
+			const double w = 2.0 * pi * frequencies_[ i ] / static_cast< double >( sample_rate_ );
+
+			rotate_re_[ i ] = static_cast< float >( k_damping * std::cos( w ) );
+			rotate_im_[ i ] = static_cast< float >( k_damping * std::sin( w ) );
+
+			// the comb has to cancel exactly what N float rotations did to the
+			// sample, so it is derived from the rounded rotation, not from w
+			const std::complex< double > rotate( rotate_re_[ i ], rotate_im_[ i ] );
+			const std::complex< double > comb = std::pow( rotate, static_cast< int >( window_length_ ) );
+
+			comb_re_[ i ] = static_cast< float >( comb.real( ) );
+			comb_im_[ i ] = static_cast< float >( comb.imag( ) );
+		}
+
+		// sum of r^m over the window, a sine of amplitude A peaks at A / 2 of it
+		const double gain = ( 1.0 - std::pow( k_damping, static_cast< double >( window_length_ ) ) ) / ( 1.0 - k_damping );
+		scale_            = static_cast< float >( 2.0 / gain );
+
+		history_.assign( window_length_, 0.0f );
+		reset( );
+	}
+
+	void sliding_dft_bank::reset( )
+	{
+		state_re_.assign( rotate_re_.size( ), 0.0f );
+		state_im_.assign( rotate_re_.size( ), 0.0f );
+		std::fill( history_.begin( ), history_.end( ), 0.0f );
+		history_pos_ = 0;
+	}
+
+	void sliding_dft_bank::push( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 || frequencies_.empty( ) )
+			return;
+
+		static const sliding_dft_fn fn = resolve_sliding_dft( );
+
+		float input[ k_block_frames ];
+		float delayed[ k_block_frames ];
+
+		for ( size_t offset = 0; offset < frame_count; offset += k_block_frames ) {
+			size_t count = std::min( k_block_frames, frame_count - offset );
+
+			for ( size_t i = 0; i < count; ++i ) {
+				const sample_t* src = samples + ( offset + i ) * channels;
+				float x             = ( channels >= 2 ) ? ( src[ 0 ] + src[ 1 ] ) * 0.5f : src[ 0 ];
+
+				input[ i ]               = x;
+				delayed[ i ]             = history_[ history_pos_ ];
+				history_[ history_pos_ ] = x;
+				history_pos_             = ( history_pos_ + 1 == window_length_ ) ? 0 : history_pos_ + 1;
+			}
+
+			fn( { input, delayed, count, rotate_re_.size( ), rotate_re_.data( ), rotate_im_.data( ), comb_re_.data( ), comb_im_.data( ),
+			      state_re_.data( ), state_im_.data( ) } );
+		}
+	}
+
+	float sliding_dft_bank::get_magnitude( size_t index ) const
+	{
+		return std::hypot( state_re_[ index ], state_im_[ index ] ) * scale_;
+	}
+
+	float sliding_dft_bank::get_magnitude_db( size_t index ) const
+	{
+		float mag = get_magnitude( index );
+		return ( mag > 1e-10f ) ? 20.0f * std::log10( mag ) : -100.0f;
+	}
+
+	float sliding_dft_bank::get_phase( size_t index ) const
+	{
+		return std::atan2( state_im_[ index ], state_re_[ index ] );
+	}
+
+} // namespace pm
@@ -0,0 +1,82 @@
+#pragma once
+
+// sliding DFT bank for tracking a small set of fixed frequencies
+
+#include "../common/types.h"
+#include <vector>
+
+namespace pm
+{
+
+	// one complex resonator per frequency over a shared window of the last N
+	// samples (rectangular, lightly damped):
+	//   Y[n] = x[n] + r e^{jw} Y[n-1] - r^N e^{jwN} x[n-N]
+	// cost is O(1) per frequency per sample and does not depend on N, so a
+	// 1 s window is as cheap as a 10 ms one. frequencies need not sit on the
+	// fs / N grid, which is what makes it useful for tuners and hum / pilot
+	// tone monitoring. state is current to the last pushed sample, phase is
+	// the instantaneous cosine phase of the component at that sample
+	class sliding_dft_bank
+	{
+	public:
+		explicit sliding_dft_bank( size_t window_length = k_default_sample_rate / 10 );
+
+		// frequencies in Hz, reconfiguring resets the state
+		void set_frequencies( const std::vector< float >& frequencies );
+		void set_window_length( size_t samples );
+		void set_sample_rate( int sample_rate );
+
+		// push interleaved samples (first two channels downmixed to mono)
+		void push( const sample_t* samples, size_t frame_count, int channels );
+		void reset( );
+
+		size_t get_bin_count( ) const
+		{
+			return frequencies_.size( );
+		}
+		float get_frequency( size_t index ) const
+		{
+			return frequencies_[ index ];
+		}
+
+		// linear peak amplitude, a full-scale sine reads 1.0 when it sits in the bin
+		float get_magnitude( size_t index ) const;
+		float get_magnitude_db( size_t index ) const;
+
+		// radians in (-pi, pi]
+		float get_phase( size_t index ) const;
+
+		size_t get_window_length( ) const
+		{
+			return window_length_;
+		}
+
+		// main-lobe half width in Hz (sample_rate / window_length)
+		float get_resolution( ) const
+		{
+			return static_cast< float >( sample_rate_ ) / static_cast< float >( window_length_ );
+		}
+
+	private:
+		int sample_rate_      = k_default_sample_rate;
+		size_t window_length_ = 0;
+		float scale_          = 0.0f;
+
+		std::vector< float > frequencies_;
+
+		// structure of arrays, padded to a multiple of 8 bins for the kernels
+		std::vector< float > rotate_re_;
+		std::vector< float > rotate_im_;
+		std::vector< float > comb_re_;
+		std::vector< float > comb_im_;
+		std::vector< float > state_re_;
+		std::vector< float > state_im_;
+
+		// last window_length_ input samples, history_pos_ is the oldest
+		std::vector< float > history_;
+		size_t history_pos_ = 0;
+
+		void update_coefficients( );
+	};
+
+} // namespace pm
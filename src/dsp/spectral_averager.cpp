@@ -0,0 +1,131 @@
+#include "spectral_averager.h"
+#include "spectral_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// bounds the linear ring at long windows / short hops
+	static constexpr size_t k_max_linear_frames = 256;
+	static constexpr float k_min_db             = -100.0f;
+
+	void spectral_averager::configure( const averaging_settings& settings )
+	{
+		settings_ = settings;
+		reset( );
+	}
+
+	void spectral_averager::reset( )
+	{
+		// forces resize( ) on the next frame
+		frame_period_ = 0.0f;
+		power_.clear( );
+		peak_ = { };
+	}
+
+	void spectral_averager::set_peak_tracking( bool enabled )
+	{
+		peak_tracking_ = enabled;
+		peak_          = { };
+	}
+
+	void spectral_averager::resize( size_t count, float frame_period )
+	{
+		frame_period_ = frame_period;
+
+		power_.assign( count, 0.0f );
+		magnitudes_.assign( count, 0.0f );
+		magnitudes_db_.assign( count, k_min_db );
+
+		if ( settings_.mode == averaging_mode::linear ) {
+			float frames    = settings_.time_ms * 0.001f / frame_period;
+			history_frames_ = std::clamp< size_t >( static_cast< size_t >( std::lround( frames ) ), 1, k_max_linear_frames );
+			history_.assign( history_frames_ * count, 0.0f );
+			sum_.assign( count, 0.0f );
+			history_pos_  = 0;
+			history_fill_ = 0;
+		} else {
+			history_.clear( );
+			sum_.clear( );
+		}
+
+		if ( settings_.mode == averaging_mode::peak_hold ) {
+			hold_remaining_.assign( count, 0.0f );
+		} else {
+			hold_remaining_.clear( );
+		}
+	}
+
+	void spectral_averager::process( const float* magnitudes, size_t count, float frame_period )
+	{
+		if ( count != power_.size( ) || frame_period != frame_period_ ) {
+			resize( count, frame_period );
+		}
+
+		switch ( settings_.mode ) {
+		case averaging_mode::none:
+			average_power( magnitudes, count, 0.0f, power_.data( ) );
+			break;
+		case averaging_mode::exponential: {
+			float tau  = std::max( settings_.time_ms * 0.001f, 1e-6f );
+			float keep = std::exp( -frame_period / tau );
+			average_power( magnitudes, count, keep, power_.data( ) );
+			break;
+		}
+		case averaging_mode::linear:
+			process_linear( magnitudes, count );
+			break;
+		case averaging_mode::peak_hold:
+			process_peak_hold( magnitudes, count, frame_period );
+			break;
+		}
+
+		if ( !peak_tracking_ ) {
+			power_to_magnitude_db( power_.data( ), count, k_min_db, magnitudes_.data( ), magnitudes_db_.data( ) );
+			return;
+		}
+
+		// the loudest bin only counts as a peak when it is a local maximum,
+		// not the slope down from a louder edge bin
+		const size_t k = power_to_magnitude_db_peak( power_.data( ), count, k_min_db, magnitudes_.data( ), magnitudes_db_.data( ) );
+		if ( k > 0 && power_[ k ] > power_[ k - 1 ] && power_[ k ] >= power_[ k + 1 ] && magnitudes_db_[ k ] > k_min_db ) {
+			peak_ = interpolate_peak( magnitudes_db_.data( ), k );
+		} else {
+			peak_ = { };
+		}
+	}
+
+	void spectral_averager::process_linear( const float* magnitudes, size_t count )
+	{
+		// re-sum the ring once per wrap, before its oldest frame is replaced,
+		// so float error in the running sum cannot build up
+		if ( history_pos_ == 0 && history_fill_ == history_frames_ ) {
+			std::fill( sum_.begin( ), sum_.end( ), 0.0f );
+			for ( size_t f = 0; f < history_frames_; ++f ) {
+				const float* frame = history_.data( ) + f * count;
+				for ( size_t i = 0; i < count; ++i ) {
+					sum_[ i ] += frame[ i ];
+				}
+			}
+		}
+
+		// partial window while filling, so the first frames are not attenuated
+		history_fill_     = std::min( history_fill_ + 1, history_frames_ );
+		const float scale = 1.0f / static_cast< float >( history_fill_ );
+
+		float* slot = history_.data( ) + history_pos_ * count;
+		window_average_power( magnitudes, count, scale, slot, sum_.data( ), power_.data( ) );
+
+		history_pos_ = ( history_pos_ + 1 ) % history_frames_;
+	}
+
+	void spectral_averager::process_peak_hold( const float* magnitudes, size_t count, float frame_period )
+	{
+		const float hold  = settings_.time_ms * 0.001f;
+		const float decay = std::pow( 10.0f, -settings_.decay_db_per_second * frame_period * 0.1f );
+
+		peak_hold_power( magnitudes, count, hold, frame_period, decay, power_.data( ), hold_remaining_.data( ) );
+	}
+
+} // namespace pm
@@ -0,0 +1,93 @@
+#pragma once
+
+// frame-rate independent spectral averaging in the power domain
+
+#include "spectral_kernels.h"
+#include <cstddef>
+#include <vector>
+
+namespace pm
+{
+
+	enum class averaging_mode {
+		none,        // latest frame only
+		exponential, // one-pole, time_ms is the time constant
+		linear,      // mean of the frames inside the last time_ms
+		peak_hold    // max, held for time_ms then decaying at decay_db_per_second
+	};
+
+	struct averaging_settings {
+		averaging_mode mode       = averaging_mode::exponential;
+		float time_ms             = 100.0f;
+		float decay_db_per_second = 20.0f;
+	};
+
+	// one set of per-bin accumulators. coefficients are derived from the real
+	// time between frames (hop / sample rate) rather than applied per call, so
+	// the ballistics do not change with hop size, fft size or how often the
+	// caller runs. several views can each own one and feed it from the same
+	// fft_processor frame
+	class spectral_averager
+	{
+	public:
+		void configure( const averaging_settings& settings );
+		const averaging_settings& get_settings( ) const
+		{
+			return settings_;
+		}
+
+		// one frame of linear magnitudes, frame_period in seconds
+		void process( const float* magnitudes, size_t count, float frame_period );
+		void reset( );
+
+		const std::vector< float >& get_power( ) const
+		{
+			return power_;
+		}
+		const std::vector< float >& get_magnitudes( ) const
+		{
+			return magnitudes_;
+		}
+		const std::vector< float >& get_magnitudes_db( ) const
+		{
+			return magnitudes_db_;
+		}
+
+		// loudest local maximum of the averaged spectrum, found in the same
+		// vectorised pass that converts it to dB. off by default
+		void set_peak_tracking( bool enabled );
+		// interpolated, db stays at the floor while there is no peak
+		const spectral_peak& get_peak( ) const
+		{
+			return peak_;
+		}
+
+	private:
+		averaging_settings settings_;
+		float frame_period_ = 0.0f;
+
+		// averaged power and the derived outputs
+		std::vector< float > power_;
+		std::vector< float > magnitudes_;
+		std::vector< float > magnitudes_db_;
+
+		bool peak_tracking_ = false;
+		spectral_peak peak_;
+
+		// linear: ring of frame powers and their running sum, re-summed on
+		// every wrap so float error cannot build up
+		std::vector< float > history_;
+		std::vector< float > sum_;
+		size_t history_frames_ = 0;
+		size_t history_pos_    = 0;
+		size_t history_fill_   = 0;
+
+		// peak hold: seconds left before each bin starts to decay
+		std::vector< float > hold_remaining_;
+
+		void resize( size_t count, float frame_period );
+		void process_linear( const float* magnitudes, size_t count );
+		void process_peak_hold( const float* magnitudes, size_t count, float frame_period );
+	};
+
+} // namespace pm
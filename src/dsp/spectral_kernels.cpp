@@ -0,0 +1,898 @@
+#include "spectral_kernels.h"
+#include "simd.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace pm
+{
+
+	// log2( 1 + t ) / t on t in [sqrt(0.5) - 1, sqrt(2) - 1), fitted on chebyshev nodes
+	static constexpr float k_log2_c0 = 1.44270182f;
+	static constexpr float k_log2_c1 = -0.721208453f;
+	static constexpr float k_log2_c2 = 0.479793876f;
+	static constexpr float k_log2_c3 = -0.366413265f;
+	static constexpr float k_log2_c4 = 0.318407118f;
+	static constexpr float k_log2_c5 = -0.206858128f;
+
+	static constexpr float k_sqrt2       = 1.41421356f;
+	static constexpr float k_db_per_log2 = 6.02059991f; // 20 * log10( 2 )
+	static constexpr float k_mag_floor   = 1e-10f;
+	static constexpr float k_power_floor = 1e-20f;
+
+	float fast_log2( float x )
+	{
+		uint32_t bits = std::bit_cast< uint32_t >( x );
+		int exponent  = static_cast< int >( ( bits >> 23 ) & 0xff ) - 127;
+		float m       = std::bit_cast< float >( ( bits & 0x007fffffu ) | 0x3f800000u );
+
+		if ( m >= k_sqrt2 ) {
+			m *= 0.5f;
+			exponent++;
+		}
+
+		float t = m - 1.0f;
+		float p = k_log2_c5;
+		p       = p * t + k_log2_c4;
+		p       = p * t + k_log2_c3;
+		p       = p * t + k_log2_c2;
+		p       = p * t + k_log2_c1;
+		p       = p * t + k_log2_c0;
+		return static_cast< float >( exponent ) + t * p;
+	}
+
+	static void magnitude_db_scalar( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes,
+	                                 float* magnitudes_db, size_t start )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			float re  = bins[ i * 2 ];
+			float im  = bins[ i * 2 + 1 ];
+			float mag = std::sqrt( re * re + im * im ) * scale;
+
+			mag                = magnitudes[ i ] * smoothing + mag * ( 1.0f - smoothing );
+			magnitudes[ i ]    = mag;
+			magnitudes_db[ i ] = std::max( k_db_per_log2 * fast_log2( std::max( mag, k_mag_floor ) ), min_db );
+		}
+	}
+
+	static void magnitude_db_generic( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes,
+	                                  float* magnitudes_db )
+	{
+		magnitude_db_scalar( bins, count, scale, smoothing, min_db, magnitudes, magnitudes_db, 0 );
+	}
+
+	static void average_power_scalar( const float* magnitudes, size_t count, float keep, float* power, size_t start )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			power[ i ] = power[ i ] * keep + magnitudes[ i ] * magnitudes[ i ] * ( 1.0f - keep );
+		}
+	}
+
+	static void average_power_generic( const float* magnitudes, size_t count, float keep, float* power )
+	{
+		average_power_scalar( magnitudes, count, keep, power, 0 );
+	}
+
+	static void window_average_power_scalar( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power, size_t start )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			float p    = magnitudes[ i ] * magnitudes[ i ];
+			sum[ i ]  += p - slot[ i ];
+			slot[ i ]  = p;
+			power[ i ] = std::max( sum[ i ], 0.0f ) * scale;
+		}
+	}
+
+	static void window_average_power_generic( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power )
+	{
+		window_average_power_scalar( magnitudes, count, scale, slot, sum, power, 0 );
+	}
+
+	static void peak_hold_power_scalar( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold,
+	                                    size_t start )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			float p = magnitudes[ i ] * magnitudes[ i ];
+			if ( p >= power[ i ] ) {
+				power[ i ] = p;
+				hold[ i ]  = hold_time;
+			} else if ( hold[ i ] > 0.0f ) {
+				hold[ i ] -= frame_period;
+			} else {
+				power[ i ] = std::max( power[ i ] * decay, p );
+			}
+		}
+	}
+
+	static void peak_hold_power_generic( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold )
+	{
+		peak_hold_power_scalar( magnitudes, count, hold_time, frame_period, decay, power, hold, 0 );
+	}
+
+	static void power_to_magnitude_db_scalar( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db, size_t start )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			float p            = std::max( power[ i ], k_power_floor );
+			magnitudes[ i ]    = std::sqrt( p );
+			magnitudes_db[ i ] = std::max( k_db_per_log2 * 0.5f * fast_log2( p ), min_db );
+		}
+	}
+
+	static void power_to_magnitude_db_generic( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		power_to_magnitude_db_scalar( power, count, min_db, magnitudes, magnitudes_db, 0 );
+	}
+
+	// best is the loudest bin before start, strictly louder wins so ties keep
+	// the lowest bin
+	static size_t power_to_magnitude_db_peak_scalar( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db,
+	                                                 size_t start, size_t best )
+	{
+		for ( size_t i = start; i < count; ++i ) {
+			float p            = std::max( power[ i ], k_power_floor );
+			magnitudes[ i ]    = std::sqrt( p );
+			magnitudes_db[ i ] = std::max( k_db_per_log2 * 0.5f * fast_log2( p ), min_db );
+			if ( power[ i ] > power[ best ] ) {
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	static size_t power_to_magnitude_db_peak_generic( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		return power_to_magnitude_db_peak_scalar( power, count, min_db, magnitudes, magnitudes_db, 0, 0 );
+	}
+
+	// loudest of the per-lane maxima, lowest bin on a tie like the scalar scan
+	[[maybe_unused]] static size_t reduce_loudest( const float* best, const int32_t* bins, size_t lanes )
+	{
+		size_t lane = 0;
+		for ( size_t i = 1; i < lanes; ++i ) {
+			if ( best[ i ] > best[ lane ] || ( best[ i ] == best[ lane ] && bins[ i ] < bins[ lane ] ) ) {
+				lane = i;
+			}
+		}
+		return static_cast< size_t >( bins[ lane ] );
+	}
+
+#if defined( PM_SIMD_X86 )
+
+	static inline __m128 log2_sse2( __m128 x )
+	{
+		__m128i bits     = _mm_castps_si128( x );
+		__m128i exponent = _mm_sub_epi32( _mm_srli_epi32( bits, 23 ), _mm_set1_epi32( 127 ) );
+		__m128 m         = _mm_castsi128_ps( _mm_or_si128( _mm_and_si128( bits, _mm_set1_epi32( 0x007fffff ) ), _mm_set1_epi32( 0x3f800000 ) ) );
+
+		__m128 big = _mm_cmpge_ps( m, _mm_set1_ps( k_sqrt2 ) );
+		m          = _mm_or_ps( _mm_andnot_ps( big, m ), _mm_and_ps( big, _mm_mul_ps( m, _mm_set1_ps( 0.5f ) ) ) );
+		__m128 e   = _mm_add_ps( _mm_cvtepi32_ps( exponent ), _mm_and_ps( big, _mm_set1_ps( 1.0f ) ) );
+
+		__m128 t = _mm_sub_ps( m, _mm_set1_ps( 1.0f ) );
+		__m128 p = _mm_set1_ps( k_log2_c5 );
+		p        = _mm_add_ps( _mm_mul_ps( p, t ), _mm_set1_ps( k_log2_c4 ) );
+		p        = _mm_add_ps( _mm_mul_ps( p, t ), _mm_set1_ps( k_log2_c3 ) );
+		p        = _mm_add_ps( _mm_mul_ps( p, t ), _mm_set1_ps( k_log2_c2 ) );
+		p        = _mm_add_ps( _mm_mul_ps( p, t ), _mm_set1_ps( k_log2_c1 ) );
+		p        = _mm_add_ps( _mm_mul_ps( p, t ), _mm_set1_ps( k_log2_c0 ) );
+		return _mm_add_ps( e, _mm_mul_ps( t, p ) );
+	}
+
+	// the vector part of fast_log2_array, returns where the tail starts
+	static size_t fast_log2_array_sse2( const float* x, size_t count, float* out )
+	{
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			_mm_storeu_ps( out + i, log2_sse2( _mm_loadu_ps( x + i ) ) );
+		}
+		return i;
+	}
+
+	static void magnitude_db_sse2( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes,
+	                               float* magnitudes_db )
+	{
+		const __m128 v_scale  = _mm_set1_ps( scale );
+		const __m128 v_keep   = _mm_set1_ps( smoothing );
+		const __m128 v_new    = _mm_set1_ps( 1.0f - smoothing );
+		const __m128 v_floor  = _mm_set1_ps( k_mag_floor );
+		const __m128 v_to_db  = _mm_set1_ps( k_db_per_log2 );
+		const __m128 v_min_db = _mm_set1_ps( min_db );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 a  = _mm_loadu_ps( bins + i * 2 );
+			__m128 b  = _mm_loadu_ps( bins + i * 2 + 4 );
+			__m128 re = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			__m128 im = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+
+			__m128 mag = _mm_mul_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( re, re ), _mm_mul_ps( im, im ) ) ), v_scale );
+			mag        = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( magnitudes + i ), v_keep ), _mm_mul_ps( mag, v_new ) );
+			_mm_storeu_ps( magnitudes + i, mag );
+
+			__m128 db = _mm_mul_ps( log2_sse2( _mm_max_ps( mag, v_floor ) ), v_to_db );
+			_mm_storeu_ps( magnitudes_db + i, _mm_max_ps( db, v_min_db ) );
+		}
+
+		magnitude_db_scalar( bins, count, scale, smoothing, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	static void average_power_sse2( const float* magnitudes, size_t count, float keep, float* power )
+	{
+		const __m128 v_keep = _mm_set1_ps( keep );
+		const __m128 v_new  = _mm_set1_ps( 1.0f - keep );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 mag = _mm_loadu_ps( magnitudes + i );
+			__m128 acc = _mm_mul_ps( _mm_loadu_ps( power + i ), v_keep );
+			_mm_storeu_ps( power + i, _mm_add_ps( acc, _mm_mul_ps( _mm_mul_ps( mag, mag ), v_new ) ) );
+		}
+
+		average_power_scalar( magnitudes, count, keep, power, i );
+	}
+
+	static void window_average_power_sse2( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power )
+	{
+		const __m128 v_scale = _mm_set1_ps( scale );
+		const __m128 v_zero  = _mm_setzero_ps( );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 mag = _mm_loadu_ps( magnitudes + i );
+			__m128 p   = _mm_mul_ps( mag, mag );
+			__m128 acc = _mm_add_ps( _mm_loadu_ps( sum + i ), _mm_sub_ps( p, _mm_loadu_ps( slot + i ) ) );
+			_mm_storeu_ps( sum + i, acc );
+			_mm_storeu_ps( slot + i, p );
+			_mm_storeu_ps( power + i, _mm_mul_ps( _mm_max_ps( acc, v_zero ), v_scale ) );
+		}
+
+		window_average_power_scalar( magnitudes, count, scale, slot, sum, power, i );
+	}
+
+	// mask ? a : b
+	static inline __m128 select_sse2( __m128 mask, __m128 a, __m128 b )
+	{
+		return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+	}
+
+	static void peak_hold_power_sse2( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold )
+	{
+		const __m128 v_hold   = _mm_set1_ps( hold_time );
+		const __m128 v_period = _mm_set1_ps( frame_period );
+		const __m128 v_decay  = _mm_set1_ps( decay );
+		const __m128 v_zero   = _mm_setzero_ps( );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 mag  = _mm_loadu_ps( magnitudes + i );
+			__m128 p    = _mm_mul_ps( mag, mag );
+			__m128 acc  = _mm_loadu_ps( power + i );
+			__m128 left = _mm_loadu_ps( hold + i );
+
+			// rising bins restart the hold, held bins count down, the rest decay
+			__m128 rise    = _mm_cmpge_ps( p, acc );
+			__m128 holding = _mm_andnot_ps( rise, _mm_cmpgt_ps( left, v_zero ) );
+			__m128 decayed = _mm_max_ps( _mm_mul_ps( acc, v_decay ), p );
+
+			_mm_storeu_ps( power + i, select_sse2( rise, p, select_sse2( holding, acc, decayed ) ) );
+			_mm_storeu_ps( hold + i, select_sse2( rise, v_hold, _mm_sub_ps( left, _mm_and_ps( holding, v_period ) ) ) );
+		}
+
+		peak_hold_power_scalar( magnitudes, count, hold_time, frame_period, decay, power, hold, i );
+	}
+
+	static void power_to_magnitude_db_sse2( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		const __m128 v_floor  = _mm_set1_ps( k_power_floor );
+		const __m128 v_to_db  = _mm_set1_ps( k_db_per_log2 * 0.5f );
+		const __m128 v_min_db = _mm_set1_ps( min_db );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 p = _mm_max_ps( _mm_loadu_ps( power + i ), v_floor );
+			_mm_storeu_ps( magnitudes + i, _mm_sqrt_ps( p ) );
+			_mm_storeu_ps( magnitudes_db + i, _mm_max_ps( _mm_mul_ps( log2_sse2( p ), v_to_db ), v_min_db ) );
+		}
+
+		power_to_magnitude_db_scalar( power, count, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	static size_t power_to_magnitude_db_peak_sse2( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		const __m128 v_floor  = _mm_set1_ps( k_power_floor );
+		const __m128 v_to_db  = _mm_set1_ps( k_db_per_log2 * 0.5f );
+		const __m128 v_min_db = _mm_set1_ps( min_db );
+		const __m128i v_step  = _mm_set1_epi32( 4 );
+
+		// per-lane running maximum and the bin it came from. power is never
+		// negative, so the first vector always replaces the -1 seed
+		__m128 v_best      = _mm_set1_ps( -1.0f );
+		__m128i v_best_bin = _mm_setzero_si128( );
+		__m128i v_bin      = _mm_setr_epi32( 0, 1, 2, 3 );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 raw     = _mm_loadu_ps( power + i );
+			__m128i louder = _mm_castps_si128( _mm_cmpgt_ps( raw, v_best ) );
+			v_best         = _mm_max_ps( raw, v_best );
+			v_best_bin     = _mm_or_si128( _mm_and_si128( louder, v_bin ), _mm_andnot_si128( louder, v_best_bin ) );
+			v_bin          = _mm_add_epi32( v_bin, v_step );
+
+			__m128 p = _mm_max_ps( raw, v_floor );
+			_mm_storeu_ps( magnitudes + i, _mm_sqrt_ps( p ) );
+			_mm_storeu_ps( magnitudes_db + i, _mm_max_ps( _mm_mul_ps( log2_sse2( p ), v_to_db ), v_min_db ) );
+		}
+
+		alignas( 16 ) float best[ 4 ];
+		alignas( 16 ) int32_t bins[ 4 ];
+		_mm_store_ps( best, v_best );
+		_mm_store_si128( reinterpret_cast< __m128i* >( bins ), v_best_bin );
+
+		return power_to_magnitude_db_peak_scalar( power, count, min_db, magnitudes, magnitudes_db, i, reduce_loudest( best, bins, 4 ) );
+	}
+
+	PM_TARGET_AVX2 static inline __m256 log2_avx2( __m256 x )
+	{
+		__m256i bits     = _mm256_castps_si256( x );
+		__m256i exponent = _mm256_sub_epi32( _mm256_srli_epi32( bits, 23 ), _mm256_set1_epi32( 127 ) );
+		__m256 m         = _mm256_castsi256_ps( _mm256_or_si256( _mm256_and_si256( bits, _mm256_set1_epi32( 0x007fffff ) ), _mm256_set1_epi32( 0x3f800000 ) ) );
+
+		__m256 big = _mm256_cmp_ps( m, _mm256_set1_ps( k_sqrt2 ), _CMP_GE_OQ );
+		m          = _mm256_blendv_ps( m, _mm256_mul_ps( m, _mm256_set1_ps( 0.5f ) ), big );
+		__m256 e   = _mm256_add_ps( _mm256_cvtepi32_ps( exponent ), _mm256_and_ps( big, _mm256_set1_ps( 1.0f ) ) );
+
+		__m256 t = _mm256_sub_ps( m, _mm256_set1_ps( 1.0f ) );
+		__m256 p = _mm256_set1_ps( k_log2_c5 );
+		p        = _mm256_fmadd_ps( p, t, _mm256_set1_ps( k_log2_c4 ) );
+		p        = _mm256_fmadd_ps( p, t, _mm256_set1_ps( k_log2_c3 ) );
+		p        = _mm256_fmadd_ps( p, t, _mm256_set1_ps( k_log2_c2 ) );
+		p        = _mm256_fmadd_ps( p, t, _mm256_set1_ps( k_log2_c1 ) );
+		p        = _mm256_fmadd_ps( p, t, _mm256_set1_ps( k_log2_c0 ) );
+		return _mm256_fmadd_ps( t, p, e );
+	}
+
+	PM_TARGET_AVX2 static size_t fast_log2_array_avx2( const float* x, size_t count, float* out )
+	{
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			_mm256_storeu_ps( out + i, log2_avx2( _mm256_loadu_ps( x + i ) ) );
+		}
+		return i;
+	}
+
+	PM_TARGET_AVX2 static void magnitude_db_avx2( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes,
+	                                              float* magnitudes_db )
+	{
+		const __m256 v_scale  = _mm256_set1_ps( scale );
+		const __m256 v_keep   = _mm256_set1_ps( smoothing );
+		const __m256 v_new    = _mm256_set1_ps( 1.0f - smoothing );
+		const __m256 v_floor  = _mm256_set1_ps( k_mag_floor );
+		const __m256 v_to_db  = _mm256_set1_ps( k_db_per_log2 );
+		const __m256 v_min_db = _mm256_set1_ps( min_db );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 a = _mm256_loadu_ps( bins + i * 2 );
+			__m256 b = _mm256_loadu_ps( bins + i * 2 + 8 );
+
+			// hadd works per 128-bit lane: bins come out as 0 1 4 5 | 2 3 6 7
+			__m256 power = _mm256_hadd_ps( _mm256_mul_ps( a, a ), _mm256_mul_ps( b, b ) );
+			power        = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd( power ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+
+			__m256 mag = _mm256_mul_ps( _mm256_sqrt_ps( power ), v_scale );
+			mag        = _mm256_fmadd_ps( _mm256_loadu_ps( magnitudes + i ), v_keep, _mm256_mul_ps( mag, v_new ) );
+			_mm256_storeu_ps( magnitudes + i, mag );
+
+			__m256 db = _mm256_mul_ps( log2_avx2( _mm256_max_ps( mag, v_floor ) ), v_to_db );
+			_mm256_storeu_ps( magnitudes_db + i, _mm256_max_ps( db, v_min_db ) );
+		}
+
+		magnitude_db_scalar( bins, count, scale, smoothing, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	PM_TARGET_AVX2 static void average_power_avx2( const float* magnitudes, size_t count, float keep, float* power )
+	{
+		const __m256 v_keep = _mm256_set1_ps( keep );
+		const __m256 v_new  = _mm256_set1_ps( 1.0f - keep );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 mag = _mm256_loadu_ps( magnitudes + i );
+			__m256 acc = _mm256_mul_ps( _mm256_loadu_ps( power + i ), v_keep );
+			_mm256_storeu_ps( power + i, _mm256_fmadd_ps( _mm256_mul_ps( mag, mag ), v_new, acc ) );
+		}
+
+		average_power_scalar( magnitudes, count, keep, power, i );
+	}
+
+	PM_TARGET_AVX2 static void window_average_power_avx2( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power )
+	{
+		const __m256 v_scale = _mm256_set1_ps( scale );
+		const __m256 v_zero  = _mm256_setzero_ps( );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 mag = _mm256_loadu_ps( magnitudes + i );
+			__m256 p   = _mm256_mul_ps( mag, mag );
+			__m256 acc = _mm256_add_ps( _mm256_loadu_ps( sum + i ), _mm256_sub_ps( p, _mm256_loadu_ps( slot + i ) ) );
+			_mm256_storeu_ps( sum + i, acc );
+			_mm256_storeu_ps( slot + i, p );
+			_mm256_storeu_ps( power + i, _mm256_mul_ps( _mm256_max_ps( acc, v_zero ), v_scale ) );
+		}
+
+		window_average_power_scalar( magnitudes, count, scale, slot, sum, power, i );
+	}
+
+	PM_TARGET_AVX2 static void peak_hold_power_avx2( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power,
+	                                                 float* hold )
+	{
+		const __m256 v_hold   = _mm256_set1_ps( hold_time );
+		const __m256 v_period = _mm256_set1_ps( frame_period );
+		const __m256 v_decay  = _mm256_set1_ps( decay );
+		const __m256 v_zero   = _mm256_setzero_ps( );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 mag  = _mm256_loadu_ps( magnitudes + i );
+			__m256 p    = _mm256_mul_ps( mag, mag );
+			__m256 acc  = _mm256_loadu_ps( power + i );
+			__m256 left = _mm256_loadu_ps( hold + i );
+
+			__m256 rise    = _mm256_cmp_ps( p, acc, _CMP_GE_OQ );
+			__m256 holding = _mm256_andnot_ps( rise, _mm256_cmp_ps( left, v_zero, _CMP_GT_OQ ) );
+			__m256 decayed = _mm256_max_ps( _mm256_mul_ps( acc, v_decay ), p );
+
+			_mm256_storeu_ps( power + i, _mm256_blendv_ps( _mm256_blendv_ps( decayed, acc, holding ), p, rise ) );
+			_mm256_storeu_ps( hold + i, _mm256_blendv_ps( _mm256_sub_ps( left, _mm256_and_ps( holding, v_period ) ), v_hold, rise ) );
+		}
+
+		peak_hold_power_scalar( magnitudes, count, hold_time, frame_period, decay, power, hold, i );
+	}
+
+	PM_TARGET_AVX2 static void power_to_magnitude_db_avx2( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		const __m256 v_floor  = _mm256_set1_ps( k_power_floor );
+		const __m256 v_to_db  = _mm256_set1_ps( k_db_per_log2 * 0.5f );
+		const __m256 v_min_db = _mm256_set1_ps( min_db );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 p = _mm256_max_ps( _mm256_loadu_ps( power + i ), v_floor );
+			_mm256_storeu_ps( magnitudes + i, _mm256_sqrt_ps( p ) );
+			_mm256_storeu_ps( magnitudes_db + i, _mm256_max_ps( _mm256_mul_ps( log2_avx2( p ), v_to_db ), v_min_db ) );
+		}
+
+		power_to_magnitude_db_scalar( power, count, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	PM_TARGET_AVX2 static size_t power_to_magnitude_db_peak_avx2( const float* power, size_t count, float min_db, float* magnitudes,
+	                                                              float* magnitudes_db )
+	{
+		const __m256 v_floor  = _mm256_set1_ps( k_power_floor );
+		const __m256 v_to_db  = _mm256_set1_ps( k_db_per_log2 * 0.5f );
+		const __m256 v_min_db = _mm256_set1_ps( min_db );
+		const __m256i v_step  = _mm256_set1_epi32( 8 );
+
+		__m256 v_best      = _mm256_set1_ps( -1.0f );
+		__m256i v_best_bin = _mm256_setzero_si256( );
+		__m256i v_bin      = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+		size_t i = 0;
+		for ( ; i + 8 <= count; i += 8 ) {
+			__m256 raw    = _mm256_loadu_ps( power + i );
+			__m256 louder = _mm256_cmp_ps( raw, v_best, _CMP_GT_OQ );
+			v_best        = _mm256_max_ps( raw, v_best );
+			v_best_bin    = _mm256_blendv_epi8( v_best_bin, v_bin, _mm256_castps_si256( louder ) );
+			v_bin         = _mm256_add_epi32( v_bin, v_step );
+
+			__m256 p = _mm256_max_ps( raw, v_floor );
+			_mm256_storeu_ps( magnitudes + i, _mm256_sqrt_ps( p ) );
+			_mm256_storeu_ps( magnitudes_db + i, _mm256_max_ps( _mm256_mul_ps( log2_avx2( p ), v_to_db ), v_min_db ) );
+		}
+
+		alignas( 32 ) float best[ 8 ];
+		alignas( 32 ) int32_t bins[ 8 ];
+		_mm256_store_ps( best, v_best );
+		_mm256_store_si256( reinterpret_cast< __m256i* >( bins ), v_best_bin );
+
+		return power_to_magnitude_db_peak_scalar( power, count, min_db, magnitudes, magnitudes_db, i, reduce_loudest( best, bins, 8 ) );
+	}
+
+	PM_TARGET_AVX2 static void gather_power_avx2( const float* values, const uint32_t* indices, const float* weights, size_t count, float* products )
+	{
+		size_t j = 0;
+		for ( ; j + 8 <= count; j += 8 ) {
+			__m256i idx = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( indices + j ) );
+			__m256 v    = _mm256_i32gather_ps( values, idx, 4 );
+			_mm256_storeu_ps( products + j, _mm256_mul_ps( _mm256_mul_ps( v, v ), _mm256_loadu_ps( weights + j ) ) );
+		}
+
+		for ( ; j < count; ++j ) {
+			float v       = values[ indices[ j ] ];
+			products[ j ] = weights[ j ] * v * v;
+		}
+	}
+
+#elif defined( PM_SIMD_NEON )
+
+	static inline float32x4_t log2_neon( float32x4_t x )
+	{
+		uint32x4_t bits    = vreinterpretq_u32_f32( x );
+		int32x4_t exponent = vsubq_s32( vreinterpretq_s32_u32( vshrq_n_u32( bits, 23 ) ), vdupq_n_s32( 127 ) );
+		float32x4_t m      = vreinterpretq_f32_u32( vorrq_u32( vandq_u32( bits, vdupq_n_u32( 0x007fffff ) ), vdupq_n_u32( 0x3f800000 ) ) );
+
+		uint32x4_t big = vcgeq_f32( m, vdupq_n_f32( k_sqrt2 ) );
+		m              = vbslq_f32( big, vmulq_n_f32( m, 0.5f ), m );
+		float32x4_t e  = vaddq_f32( vcvtq_f32_s32( exponent ), vreinterpretq_f32_u32( vandq_u32( big, vreinterpretq_u32_f32( vdupq_n_f32( 1.0f ) ) ) ) );
+
+		float32x4_t t = vsubq_f32( m, vdupq_n_f32( 1.0f ) );
+		float32x4_t p = vdupq_n_f32( k_log2_c5 );
+		p             = vfmaq_f32( vdupq_n_f32( k_log2_c4 ), p, t );
+		p             = vfmaq_f32( vdupq_n_f32( k_log2_c3 ), p, t );
+		p             = vfmaq_f32( vdupq_n_f32( k_log2_c2 ), p, t );
+		p             = vfmaq_f32( vdupq_n_f32( k_log2_c1 ), p, t );
+		p             = vfmaq_f32( vdupq_n_f32( k_log2_c0 ), p, t );
+		return vfmaq_f32( e, t, p );
+	}
+
+	static size_t fast_log2_array_neon( const float* x, size_t count, float* out )
+	{
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			vst1q_f32( out + i, log2_neon( vld1q_f32( x + i ) ) );
+		}
+		return i;
+	}
+
+	static void magnitude_db_neon( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes,
+	                               float* magnitudes_db )
+	{
+		const float32x4_t v_floor  = vdupq_n_f32( k_mag_floor );
+		const float32x4_t v_min_db = vdupq_n_f32( min_db );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x2_t v   = vld2q_f32( bins + i * 2 );
+			float32x4_t power = vfmaq_f32( vmulq_f32( v.val[ 0 ], v.val[ 0 ] ), v.val[ 1 ], v.val[ 1 ] );
+
+			float32x4_t mag = vmulq_n_f32( vsqrtq_f32( power ), scale );
+			mag             = vfmaq_n_f32( vmulq_n_f32( mag, 1.0f - smoothing ), vld1q_f32( magnitudes + i ), smoothing );
+			vst1q_f32( magnitudes + i, mag );
+
+			float32x4_t db = vmulq_n_f32( log2_neon( vmaxq_f32( mag, v_floor ) ), k_db_per_log2 );
+			vst1q_f32( magnitudes_db + i, vmaxq_f32( db, v_min_db ) );
+		}
+
+		magnitude_db_scalar( bins, count, scale, smoothing, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	static void average_power_neon( const float* magnitudes, size_t count, float keep, float* power )
+	{
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4_t mag = vld1q_f32( magnitudes + i );
+			float32x4_t acc = vmulq_n_f32( vld1q_f32( power + i ), keep );
+			vst1q_f32( power + i, vfmaq_n_f32( acc, vmulq_f32( mag, mag ), 1.0f - keep ) );
+		}
+
+		average_power_scalar( magnitudes, count, keep, power, i );
+	}
+
+	static void window_average_power_neon( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power )
+	{
+		const float32x4_t v_zero = vdupq_n_f32( 0.0f );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4_t mag = vld1q_f32( magnitudes + i );
+			float32x4_t p   = vmulq_f32( mag, mag );
+			float32x4_t acc = vaddq_f32( vld1q_f32( sum + i ), vsubq_f32( p, vld1q_f32( slot + i ) ) );
+			vst1q_f32( sum + i, acc );
+			vst1q_f32( slot + i, p );
+			vst1q_f32( power + i, vmulq_n_f32( vmaxq_f32( acc, v_zero ), scale ) );
+		}
+
+		window_average_power_scalar( magnitudes, count, scale, slot, sum, power, i );
+	}
+
+	static void peak_hold_power_neon( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold )
+	{
+		const float32x4_t v_hold = vdupq_n_f32( hold_time );
+		const float32x4_t v_zero = vdupq_n_f32( 0.0f );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4_t mag  = vld1q_f32( magnitudes + i );
+			float32x4_t p    = vmulq_f32( mag, mag );
+			float32x4_t acc  = vld1q_f32( power + i );
+			float32x4_t left = vld1q_f32( hold + i );
+
+			uint32x4_t rise       = vcgeq_f32( p, acc );
+			uint32x4_t holding    = vbicq_u32( vcgtq_f32( left, v_zero ), rise );
+			float32x4_t decayed   = vmaxq_f32( vmulq_n_f32( acc, decay ), p );
+			float32x4_t countdown = vsubq_f32( left, vbslq_f32( holding, vdupq_n_f32( frame_period ), v_zero ) );
+
+			vst1q_f32( power + i, vbslq_f32( rise, p, vbslq_f32( holding, acc, decayed ) ) );
+			vst1q_f32( hold + i, vbslq_f32( rise, v_hold, countdown ) );
+		}
+
+		peak_hold_power_scalar( magnitudes, count, hold_time, frame_period, decay, power, hold, i );
+	}
+
+	static void power_to_magnitude_db_neon( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		const float32x4_t v_floor  = vdupq_n_f32( k_power_floor );
+		const float32x4_t v_min_db = vdupq_n_f32( min_db );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4_t p = vmaxq_f32( vld1q_f32( power + i ), v_floor );
+			vst1q_f32( magnitudes + i, vsqrtq_f32( p ) );
+			vst1q_f32( magnitudes_db + i, vmaxq_f32( vmulq_n_f32( log2_neon( p ), k_db_per_log2 * 0.5f ), v_min_db ) );
+		}
+
+		power_to_magnitude_db_scalar( power, count, min_db, magnitudes, magnitudes_db, i );
+	}
+
+	static size_t power_to_magnitude_db_peak_neon( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		const float32x4_t v_floor    = vdupq_n_f32( k_power_floor );
+		const float32x4_t v_min_db   = vdupq_n_f32( min_db );
+		const int32_t lane_bins[ 4 ] = { 0, 1, 2, 3 };
+
+		float32x4_t v_best   = vdupq_n_f32( -1.0f );
+		int32x4_t v_best_bin = vdupq_n_s32( 0 );
+		int32x4_t v_bin      = vld1q_s32( lane_bins );
+
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4_t raw   = vld1q_f32( power + i );
+			uint32x4_t louder = vcgtq_f32( raw, v_best );
+			v_best            = vmaxq_f32( raw, v_best );
+			v_best_bin        = vbslq_s32( louder, v_bin, v_best_bin );
+			v_bin             = vaddq_s32( v_bin, vdupq_n_s32( 4 ) );
+
+			float32x4_t p = vmaxq_f32( raw, v_floor );
+			vst1q_f32( magnitudes + i, vsqrtq_f32( p ) );
+			vst1q_f32( magnitudes_db + i, vmaxq_f32( vmulq_n_f32( log2_neon( p ), k_db_per_log2 * 0.5f ), v_min_db ) );
+		}
+
+		float best[ 4 ];
+		int32_t bins[ 4 ];
+		vst1q_f32( best, v_best );
+		vst1q_s32( bins, v_best_bin );
+
+		return power_to_magnitude_db_peak_scalar( power, count, min_db, magnitudes, magnitudes_db, i, reduce_loudest( best, bins, 4 ) );
+	}
+
+#endif
+
+	bool fast_log2_array( simd::isa isa, const float* x, size_t count, float* out )
+	{
+		size_t i = 0;
+		switch ( isa ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			i = fast_log2_array_avx2( x, count, out );
+			break;
+		case simd::isa::sse2:
+			i = fast_log2_array_sse2( x, count, out );
+			break;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			i = fast_log2_array_neon( x, count, out );
+			break;
+#endif
+		case simd::isa::scalar:
+			break;
+		default:
+			return false;
+		}
+
+		for ( ; i < count; ++i ) {
+			out[ i ] = fast_log2( x[ i ] );
+		}
+		return true;
+	}
+
+	using magnitude_db_fn = void ( * )( const float*, size_t, float, float, float, float*, float* );
+
+	static magnitude_db_fn resolve_magnitude_db( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return magnitude_db_avx2;
+		case simd::isa::sse2:
+			return magnitude_db_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return magnitude_db_neon;
+#endif
+		default:
+			return magnitude_db_generic;
+		}
+	}
+
+	void magnitude_db( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		static const magnitude_db_fn fn = resolve_magnitude_db( );
+		fn( bins, count, scale, smoothing, min_db, magnitudes, magnitudes_db );
+	}
+
+	using average_power_fn         = void ( * )( const float*, size_t, float, float* );
+	using power_to_magnitude_db_fn = void ( * )( const float*, size_t, float, float*, float* );
+
+	static average_power_fn resolve_average_power( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return average_power_avx2;
+		case simd::isa::sse2:
+			return average_power_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return average_power_neon;
+#endif
+		default:
+			return average_power_generic;
+		}
+	}
+
+	static power_to_magnitude_db_fn resolve_power_to_magnitude_db( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return power_to_magnitude_db_avx2;
+		case simd::isa::sse2:
+			return power_to_magnitude_db_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return power_to_magnitude_db_neon;
+#endif
+		default:
+			return power_to_magnitude_db_generic;
+		}
+	}
+
+	void average_power( const float* magnitudes, size_t count, float keep, float* power )
+	{
+		static const average_power_fn fn = resolve_average_power( );
+		fn( magnitudes, count, keep, power );
+	}
+
+	using window_average_power_fn = void ( * )( const float*, size_t, float, float*, float*, float* );
+	using peak_hold_power_fn      = void ( * )( const float*, size_t, float, float, float, float*, float* );
+
+	static window_average_power_fn resolve_window_average_power( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return window_average_power_avx2;
+		case simd::isa::sse2:
+			return window_average_power_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return window_average_power_neon;
+#endif
+		default:
+			return window_average_power_generic;
+		}
+	}
+
+	static peak_hold_power_fn resolve_peak_hold_power( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return peak_hold_power_avx2;
+		case simd::isa::sse2:
+			return peak_hold_power_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return peak_hold_power_neon;
+#endif
+		default:
+			return peak_hold_power_generic;
+		}
+	}
+
+	void window_average_power( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power )
+	{
+		static const window_average_power_fn fn = resolve_window_average_power( );
+		fn( magnitudes, count, scale, slot, sum, power );
+	}
+
+	void peak_hold_power( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold )
+	{
+		static const peak_hold_power_fn fn = resolve_peak_hold_power( );
+		fn( magnitudes, count, hold_time, frame_period, decay, power, hold );
+	}
+
+	void power_to_magnitude_db( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		static const power_to_magnitude_db_fn fn = resolve_power_to_magnitude_db( );
+		fn( power, count, min_db, magnitudes, magnitudes_db );
+	}
+
+	using power_to_magnitude_db_peak_fn = size_t ( * )( const float*, size_t, float, float*, float* );
+
+	static power_to_magnitude_db_peak_fn resolve_power_to_magnitude_db_peak( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return power_to_magnitude_db_peak_avx2;
+		case simd::isa::sse2:
+			return power_to_magnitude_db_peak_sse2;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return power_to_magnitude_db_peak_neon;
+#endif
+		default:
+			return power_to_magnitude_db_peak_generic;
+		}
+	}
+
+	size_t power_to_magnitude_db_peak( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db )
+	{
+		if ( count < 3 ) {
+			power_to_magnitude_db( power, count, min_db, magnitudes, magnitudes_db );
+			return 0;
+		}
+
+		// the edges on their own, the interior is scanned and converted at once
+		power_to_magnitude_db_scalar( power, 1, min_db, magnitudes, magnitudes_db, 0 );
+		power_to_magnitude_db_scalar( power, count, min_db, magnitudes, magnitudes_db, count - 1 );
+
+		static const power_to_magnitude_db_peak_fn fn = resolve_power_to_magnitude_db_peak( );
+		return 1 + fn( power + 1, count - 2, min_db, magnitudes + 1, magnitudes_db + 1 );
+	}
+
+	spectral_peak interpolate_peak( const float* db, size_t k )
+	{
+		float a = db[ k - 1 ];
+		float b = db[ k ];
+		float c = db[ k + 1 ];
+
+		// vertex of the parabola through ( -1, a ), ( 0, b ), ( 1, c )
+		float denom  = a - 2.0f * b + c;
+		float offset = ( denom < 0.0f ) ? 0.5f * ( a - c ) / denom : 0.0f;
+
+		spectral_peak peak;
+		peak.bin = static_cast< float >( k ) + offset;
+		peak.db  = b - 0.25f * ( a - c ) * offset;
+		return peak;
+	}
+
+	// sse2 and neon have no gather, the plain loop is as good as it gets there
+	static void gather_power_generic( const float* values, const uint32_t* indices, const float* weights, size_t count, float* products )
+	{
+		for ( size_t j = 0; j < count; ++j ) {
+			float v       = values[ indices[ j ] ];
+			products[ j ] = weights[ j ] * v * v;
+		}
+	}
+
+	using gather_power_fn = void ( * )( const float*, const uint32_t*, const float*, size_t, float* );
+
+	static gather_power_fn resolve_gather_power( )
+	{
+#if defined( PM_SIMD_X86 )
+		if ( simd::get_isa( ) == simd::isa::avx2 )
+			return gather_power_avx2;
+#endif
+		return gather_power_generic;
+	}
+
+	void gather_power( const float* values, const uint32_t* indices, const float* weights, size_t count, float* products )
+	{
+		static const gather_power_fn fn = resolve_gather_power( );
+		fn( values, indices, weights, count, products );
+	}
+
+} // namespace pm
@@ -0,0 +1,75 @@
+#pragma once
+
+// vectorised post-FFT kernels, dispatched at runtime by CPU feature
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pm::simd
+{
+	enum class isa; // simd.h
+}
+
+namespace pm
+{
+
+	// fast log2 used by the dB kernels. mantissa is reduced to [sqrt(0.5), sqrt(2))
+	// and log2(1 + t) is evaluated as t * p(t) with a degree-5 fit. against
+	// double-precision std::log10 over 1e-30..1e30 the absolute error stays below
+	// 1e-5, i.e. under 1e-4 dB once scaled to 20 * log10, on every vector path
+	// (tests/spectral_kernels_test.cpp). zero, denormals and negative inputs are
+	// not handled, callers clamp to a positive floor first
+	float fast_log2( float x );
+
+	// fast_log2 over an array on one instruction set's path, the same code the
+	// dB kernels inline, so every path the host runs can be held to the bound
+	// above. false if that path is not compiled in
+	bool fast_log2_array( simd::isa isa, const float* x, size_t count, float* out );
+
+	// one pass over N complex bins (interleaved re/im, kiss_fft_cpx layout):
+	//   mag  = sqrt( re^2 + im^2 ) * scale
+	//   mag  = prev * smoothing + mag * ( 1 - smoothing )
+	//   db   = max( 20 * log10( mag ), min_db )
+	// magnitudes holds the previous frame on entry and is updated in place
+	void magnitude_db( const float* bins, size_t count, float scale, float smoothing, float min_db, float* magnitudes, float* magnitudes_db );
+
+	// power domain averaging, one accumulator per bin:
+	//   power = power * keep + magnitude^2 * ( 1 - keep )
+	void average_power( const float* magnitudes, size_t count, float keep, float* power );
+
+	// sliding mean over a ring of frame powers, slot is the ring entry being
+	// replaced and sum the running total over the ring:
+	//   p = magnitude^2, sum += p - slot, slot = p, power = max( sum, 0 ) * scale
+	void window_average_power( const float* magnitudes, size_t count, float scale, float* slot, float* sum, float* power );
+
+	// peak hold with decay, hold is the time left per bin before it decays:
+	//   p = magnitude^2 >= power:  power = p, hold = hold_time
+	//   hold > 0:                  hold -= frame_period
+	//   otherwise:                 power = max( power * decay, p )
+	void peak_hold_power( const float* magnitudes, size_t count, float hold_time, float frame_period, float decay, float* power, float* hold );
+
+	// output pass for averaged power:
+	//   magnitude = sqrt( power ), db = max( 10 * log10( power ), min_db )
+	void power_to_magnitude_db( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db );
+
+	// power_to_magnitude_db that also finds the loudest bin in the same pass.
+	// only bins in [1, count - 1) are candidates, the edge bins have a
+	// neighbour on one side and are converted but never reported. returns 0
+	// when count < 3
+	size_t power_to_magnitude_db_peak( const float* power, size_t count, float min_db, float* magnitudes, float* magnitudes_db );
+
+	struct spectral_peak {
+		float bin = 0.0f; // fractional bin index
+		float db  = -100.0f;
+	};
+
+	// position and level of the maximum at bin k ( 0 < k < count - 1 ),
+	// refined with a parabola through the three dB values around it, which
+	// is a gaussian fit in the linear domain (within ~0.05 bins for hann)
+	spectral_peak interpolate_peak( const float* db, size_t k );
+
+	// weighted power gather for band reduction:
+	//   products[ j ] = weights[ j ] * values[ indices[ j ] ]^2
+	void gather_power( const float* values, const uint32_t* indices, const float* weights, size_t count, float* products );
+
+} // namespace pm
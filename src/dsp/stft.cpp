@@ -0,0 +1,128 @@
+#include "stft.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pm
+{
+
+	// history length in frames. with hop = fft_size / 4 a full block emits
+	// five frames per slide
+	static constexpr size_t k_history_frames = 2;
+
+	stft::stft( size_t fft_size, size_t hop_size, stft_input input ) : fft_( fft_size ), input_( input ), hop_size_( hop_size )
+	{
+		history_l_.resize( fft_size * k_history_frames );
+		history_r_.resize( input_ == stft_input::stereo ? fft_size * k_history_frames : 0 );
+		set_hop_size( hop_size );
+	}
+
+	void stft::set_fft_size( size_t size )
+	{
+		fft_.set_fft_size( size );
+		history_l_.resize( size * k_history_frames );
+		history_r_.resize( input_ == stft_input::stereo ? size * k_history_frames : 0 );
+		set_hop_size( hop_size_ );
+	}
+
+	void stft::reserve( size_t max_fft_size )
+	{
+		fft_.reserve( max_fft_size );
+		history_l_.reserve( max_fft_size * k_history_frames );
+		if ( input_ == stft_input::stereo ) {
+			history_r_.reserve( max_fft_size * k_history_frames );
+		}
+	}
+
+	void stft::set_hop_size( size_t hop_size )
+	{
+		hop_size_ = std::clamp< size_t >( hop_size, 1, fft_.get_fft_size( ) );
+		reset( );
+	}
+
+	void stft::set_frame_rate( float frames_per_second )
+	{
+		if ( frames_per_second <= 0.0f )
+			return;
+		set_hop_size( static_cast< size_t >( std::lround( fft_.get_sample_rate( ) / frames_per_second ) ) );
+	}
+
+	void stft::reset( )
+	{
+		std::fill( history_l_.begin( ), history_l_.end( ), 0.0f );
+		std::fill( history_r_.begin( ), history_r_.end( ), 0.0f );
+
+		// start one hop short of a full frame so the first frame is emitted
+		// after hop_size_ samples instead of a whole fft_size of latency
+		fill_        = fft_.get_fft_size( ) - hop_size_;
+		frame_start_ = 0;
+	}
+
+	size_t stft::push( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return 0;
+
+		const size_t fft_size = fft_.get_fft_size( );
+		const size_t capacity = history_l_.size( );
+		size_t frames         = 0;
+		size_t offset         = 0;
+
+		while ( offset < frame_count ) {
+			size_t count        = std::min( frame_count - offset, capacity - fill_ );
+			const sample_t* src = samples + offset * channels;
+
+			if ( input_ == stft_input::stereo ) {
+				for ( size_t i = 0; i < count; ++i ) {
+					float l                 = src[ i * channels ];
+					history_l_[ fill_ + i ] = l;
+					history_r_[ fill_ + i ] = ( channels >= 2 ) ? src[ i * channels + 1 ] : l;
+				}
+			} else {
+				for ( size_t i = 0; i < count; ++i ) {
+					float l                 = src[ i * channels ];
+					float r                 = ( channels >= 2 ) ? src[ i * channels + 1 ] : l;
+					history_l_[ fill_ + i ] = ( l + r ) * 0.5f;
+				}
+			}
+
+			fill_ += count;
+			offset += count;
+
+			// every frame this block completed, then one slide keeps the start
+			// of the next. fill_ stays below fft_size afterwards, so the next
+			// block always has room
+			size_t start = 0;
+			for ( ; start + fft_size <= fill_; start += hop_size_ ) {
+				emit_frame( start );
+				frames++;
+			}
+
+			if ( start > 0 ) {
+				std::copy( history_l_.begin( ) + start, history_l_.begin( ) + fill_, history_l_.begin( ) );
+				if ( input_ == stft_input::stereo ) {
+					std::copy( history_r_.begin( ) + start, history_r_.begin( ) + fill_, history_r_.begin( ) );
+				}
+				fill_ -= start;
+			}
+		}
+
+		return frames;
+	}
+
+	void stft::emit_frame( size_t start )
+	{
+		const size_t fft_size = fft_.get_fft_size( );
+
+		frame_start_ = start;
+		if ( input_ == stft_input::stereo ) {
+			fft_.process_stereo( history_l_.data( ) + start, history_r_.data( ) + start, fft_size );
+		} else {
+			fft_.process( history_l_.data( ) + start, fft_size );
+		}
+
+		if ( callback_ ) {
+			callback_( fft_ );
+		}
+	}
+
+} // namespace pm
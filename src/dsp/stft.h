@@ -0,0 +1,109 @@
+#pragma once
+
+// short-time fourier transform engine with fixed hop
+
+#include "fft_processor.h"
+#include <functional>
+#include <vector>
+
+namespace pm
+{
+
+	enum class stft_input {
+		mono,  // L/R downmixed, process()
+		stereo // L/R kept separate, process_stereo()
+	};
+
+	// called once per completed frame, after the processor has been updated
+	using stft_frame_callback_t = std::function< void( const fft_processor& fft ) >;
+
+	// keeps its own input history so every transform sees a full, unpadded
+	// frame and frames are emitted every hop_size samples regardless of how
+	// the capture side chunks the audio. analysis rate = sample_rate / hop_size
+	class stft
+	{
+	public:
+		explicit stft( size_t fft_size = k_fft_size_4096, size_t hop_size = k_fft_size_4096 / 4, stft_input input = stft_input::stereo );
+
+		// push interleaved samples, returns the number of frames processed (0 or more)
+		size_t push( const sample_t* samples, size_t frame_count, int channels );
+
+		// drop history and restart framing
+		void reset( );
+
+		// configuration
+		void set_fft_size( size_t size );
+		size_t get_fft_size( ) const
+		{
+			return fft_.get_fft_size( );
+		}
+
+		// pre-size history and processor buffers so set_fft_size( ) up to
+		// max_fft_size does not allocate
+		void reserve( size_t max_fft_size );
+
+		// hop is clamped to [1, fft_size]
+		void set_hop_size( size_t hop_size );
+		size_t get_hop_size( ) const
+		{
+			return hop_size_;
+		}
+
+		// convenience: pick the hop that gives the requested frames per second
+		void set_frame_rate( float frames_per_second );
+		float get_frame_rate( ) const
+		{
+			return static_cast< float >( fft_.get_sample_rate( ) ) / static_cast< float >( hop_size_ );
+		}
+
+		void set_sample_rate( int sample_rate )
+		{
+			fft_.set_sample_rate( sample_rate );
+		}
+
+		void set_frame_callback( stft_frame_callback_t callback )
+		{
+			callback_ = std::move( callback );
+		}
+
+		// unwindowed samples of the frame being emitted, get_fft_size( ) of
+		// them. only meaningful inside the frame callback. right is nullptr for
+		// mono input
+		const sample_t* get_frame_left( ) const
+		{
+			return history_l_.data( ) + frame_start_;
+		}
+		const sample_t* get_frame_right( ) const
+		{
+			return history_r_.empty( ) ? nullptr : history_r_.data( ) + frame_start_;
+		}
+
+		fft_processor& get_processor( )
+		{
+			return fft_;
+		}
+		const fft_processor& get_processor( ) const
+		{
+			return fft_;
+		}
+
+	private:
+		fft_processor fft_;
+		stft_input input_;
+		size_t hop_size_;
+
+		// linear history of two frames, [0, fill_) is valid. a push fills it,
+		// every frame completed by then is emitted back to back, and what the
+		// next frame needs slides to the front once per block instead of once
+		// per hop
+		std::vector< sample_t > history_l_;
+		std::vector< sample_t > history_r_;
+		size_t fill_        = 0;
+		size_t frame_start_ = 0;
+
+		stft_frame_callback_t callback_;
+
+		void emit_frame( size_t start );
+	};
+
+} // namespace pm
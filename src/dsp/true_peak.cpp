@@ -0,0 +1,336 @@
+#include "true_peak.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace pm
+{
+
+	// BS.1770-4 Annex 2, 48-tap 4x interpolator. row p holds h[ p + 4k ]
+	static constexpr float k_annex2_filter[ 4 ][ 12 ] = {
+	    { 0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f, 0.9721679687500f,
+	      -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f },
+	    { -0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f, 0.7797851562500f,
+	      -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f },
+	    { -0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f, 0.4650878906250f,
+	      -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f },
+	    { -0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f, 0.1373291015625f,
+	      -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f } };
+
+	// 8x: taps per phase and kaiser shape of the designed filter
+	static constexpr int k_taps_8x      = 16;
+	static constexpr double k_kaiser_8x = 7.0;
+
+	// frames per kernel call, bounds the history buffer
+	static constexpr size_t k_block_frames = 1024;
+
+	// zeroth order modified bessel function of the first kind, for the kaiser window
+	static double bessel_i0( double x )
+	{
+		double sum  = 1.0;
+		double term = 1.0;
+		for ( int k = 1; k < 32; ++k ) {
+			term *= ( x / ( 2.0 * k ) ) * ( x / ( 2.0 * k ) );
+			sum += term;
+		}
+		return sum;
+	}
+
+	// history points at a channel pair's history, whose frame taps - 1 is the
+	// first new one. peak[ 0..1 ] receives the largest magnitude per channel
+	// over every interpolated phase and the input samples themselves
+	template< int Phases >
+	static void true_peak_pair_generic( const float* history, size_t frames, const float* coefficients, int taps, float* peak )
+	{
+		constexpr int lanes = Phases * 2;
+
+		for ( size_t n = 0; n < frames; ++n ) {
+			const float* x = history + ( n + taps - 1 ) * 2;
+
+			float acc[ lanes ] = { };
+			for ( int k = 0; k < taps; ++k ) {
+				const float* c = coefficients + k * lanes;
+				const float* s = x - k * 2;
+				for ( int l = 0; l < lanes; ++l ) {
+					acc[ l ] += c[ l ] * s[ l & 1 ];
+				}
+			}
+
+			for ( int l = 0; l < lanes; ++l ) {
+				peak[ l & 1 ] = std::max( peak[ l & 1 ], std::fabs( acc[ l ] ) );
+			}
+			peak[ 0 ] = std::max( peak[ 0 ], std::fabs( x[ 0 ] ) );
+			peak[ 1 ] = std::max( peak[ 1 ], std::fabs( x[ 1 ] ) );
+		}
+	}
+
+#if defined( PM_SIMD_X86 )
+
+	// frame broadcast as L R L R, matching the coefficient lanes
+	template< int Phases >
+	static void true_peak_pair_sse2( const float* history, size_t frames, const float* coefficients, int taps, float* peak )
+	{
+		constexpr int groups = Phases * 2 / 4;
+
+		const __m128 sign = _mm_set1_ps( -0.0f );
+		__m128 pk         = _mm_setzero_ps( );
+
+		for ( size_t n = 0; n < frames; ++n ) {
+			const float* x = history + ( n + taps - 1 ) * 2;
+
+			__m128 acc[ groups ];
+			for ( int g = 0; g < groups; ++g ) {
+				acc[ g ] = _mm_setzero_ps( );
+			}
+
+			for ( int k = 0; k < taps; ++k ) {
+				__m128 s       = _mm_castsi128_ps( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( x - k * 2 ) ) );
+				s              = _mm_movelh_ps( s, s );
+				const float* c = coefficients + k * Phases * 2;
+				for ( int g = 0; g < groups; ++g ) {
+					acc[ g ] = _mm_add_ps( acc[ g ], _mm_mul_ps( _mm_loadu_ps( c + g * 4 ), s ) );
+				}
+			}
+
+			for ( int g = 0; g < groups; ++g ) {
+				pk = _mm_max_ps( pk, _mm_andnot_ps( sign, acc[ g ] ) );
+			}
+			__m128 s = _mm_castsi128_ps( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( x ) ) );
+			pk       = _mm_max_ps( pk, _mm_andnot_ps( sign, s ) );
+		}
+
+		alignas( 16 ) float lanes[ 4 ];
+		_mm_store_ps( lanes, pk );
+		peak[ 0 ] = std::max( { peak[ 0 ], lanes[ 0 ], lanes[ 2 ] } );
+		peak[ 1 ] = std::max( { peak[ 1 ], lanes[ 1 ], lanes[ 3 ] } );
+	}
+
+	template< int Phases >
+	PM_TARGET_AVX2 static void true_peak_pair_avx2( const float* history, size_t frames, const float* coefficients, int taps, float* peak )
+	{
+		constexpr int groups = Phases * 2 / 8;
+
+		const __m256 sign = _mm256_set1_ps( -0.0f );
+		__m256 pk         = _mm256_setzero_ps( );
+
+		for ( size_t n = 0; n < frames; ++n ) {
+			const float* x = history + ( n + taps - 1 ) * 2;
+
+			__m256 acc[ groups ];
+			for ( int g = 0; g < groups; ++g ) {
+				acc[ g ] = _mm256_setzero_ps( );
+			}
+
+			for ( int k = 0; k < taps; ++k ) {
+				const __m128d pair = _mm_castsi128_pd( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( x - k * 2 ) ) );
+				const __m256 s     = _mm256_castpd_ps( _mm256_broadcastsd_pd( pair ) );
+				const float* c     = coefficients + k * Phases * 2;
+				for ( int g = 0; g < groups; ++g ) {
+					acc[ g ] = _mm256_fmadd_ps( _mm256_loadu_ps( c + g * 8 ), s, acc[ g ] );
+				}
+			}
+
+			for ( int g = 0; g < groups; ++g ) {
+				pk = _mm256_max_ps( pk, _mm256_andnot_ps( sign, acc[ g ] ) );
+			}
+			const __m128d pair = _mm_castsi128_pd( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( x ) ) );
+			pk                 = _mm256_max_ps( pk, _mm256_andnot_ps( sign, _mm256_castpd_ps( _mm256_broadcastsd_pd( pair ) ) ) );
+		}
+
+		alignas( 32 ) float lanes[ 8 ];
+		_mm256_store_ps( lanes, pk );
+		peak[ 0 ] = std::max( { peak[ 0 ], lanes[ 0 ], lanes[ 2 ], lanes[ 4 ], lanes[ 6 ] } );
+		peak[ 1 ] = std::max( { peak[ 1 ], lanes[ 1 ], lanes[ 3 ], lanes[ 5 ], lanes[ 7 ] } );
+	}
+
+#elif defined( PM_SIMD_NEON )
+
+	template< int Phases >
+	static void true_peak_pair_neon( const float* history, size_t frames, const float* coefficients, int taps, float* peak )
+	{
+		constexpr int groups = Phases * 2 / 4;
+
+		float32x4_t pk = vdupq_n_f32( 0.0f );
+
+		for ( size_t n = 0; n < frames; ++n ) {
+			const float* x = history + ( n + taps - 1 ) * 2;
+
+			float32x4_t acc[ groups ];
+			for ( int g = 0; g < groups; ++g ) {
+				acc[ g ] = vdupq_n_f32( 0.0f );
+			}
+
+			for ( int k = 0; k < taps; ++k ) {
+				const float32x2_t pair = vld1_f32( x - k * 2 );
+				const float32x4_t s    = vcombine_f32( pair, pair );
+				const float* c         = coefficients + k * Phases * 2;
+				for ( int g = 0; g < groups; ++g ) {
+					acc[ g ] = vfmaq_f32( acc[ g ], vld1q_f32( c + g * 4 ), s );
+				}
+			}
+
+			for ( int g = 0; g < groups; ++g ) {
+				pk = vmaxq_f32( pk, vabsq_f32( acc[ g ] ) );
+			}
+			const float32x2_t pair = vld1_f32( x );
+			pk                     = vmaxq_f32( pk, vabsq_f32( vcombine_f32( pair, pair ) ) );
+		}
+
+		peak[ 0 ] = std::max( { peak[ 0 ], vgetq_lane_f32( pk, 0 ), vgetq_lane_f32( pk, 2 ) } );
+		peak[ 1 ] = std::max( { peak[ 1 ], vgetq_lane_f32( pk, 1 ), vgetq_lane_f32( pk, 3 ) } );
+	}
+
+#endif
+
+	using true_peak_pair_fn = void ( * )( const float*, size_t, const float*, int, float* );
+
+	template< int Phases >
+	static true_peak_pair_fn resolve_true_peak_pair( )
+	{
+		switch ( simd::get_isa( ) ) {
+#if defined( PM_SIMD_X86 )
+		case simd::isa::avx2:
+			return true_peak_pair_avx2< Phases >;
+		case simd::isa::sse2:
+			return true_peak_pair_sse2< Phases >;
+#elif defined( PM_SIMD_NEON )
+		case simd::isa::neon:
+			return true_peak_pair_neon< Phases >;
+#endif
+		default:
+			return true_peak_pair_generic< Phases >;
+		}
+	}
+
+	static true_peak_pair_fn get_true_peak_pair( int phases )
+	{
+		static const true_peak_pair_fn fn_4x = resolve_true_peak_pair< 4 >( );
+		static const true_peak_pair_fn fn_8x = resolve_true_peak_pair< 8 >( );
+		return ( phases == 8 ) ? fn_8x : fn_4x;
+	}
+
+	true_peak_meter::true_peak_meter( int oversampling )
+	{
+		set_oversampling( oversampling );
+	}
+
+	void true_peak_meter::set_oversampling( int factor )
+	{
+		phases_ = ( factor >= 6 ) ? 8 : 4;
+		taps_   = ( phases_ == 8 ) ? k_taps_8x : 12;
+		design( );
+
+		channels_ = 0;
+		reset( );
+	}
+
+	void true_peak_meter::design( )
+	{
+		// filter taps h[ p + phases * k ], one row per phase
+		std::vector< double > h( static_cast< size_t >( phases_ * taps_ ) );
+
+		if ( phases_ == 4 ) {
+			for ( int p = 0; p < 4; ++p ) {
+				for ( int k = 0; k < 12; ++k ) {
+					h[ p + 4 * k ] = k_annex2_filter[ p ][ k ];
+				}
+			}
+		} else {
+			// windowed sinc cut off at the input nyquist, each phase normalised
+			// to unity DC gain so a constant reads its own level
+			const double pi     = 3.14159265358979323846;
+			const int length    = phases_ * taps_;
+			const double centre = ( length - 1 ) * 0.5;
+			const double norm   = bessel_i0( k_kaiser_8x );
+
+			for ( int m = 0; m < length; ++m ) {
+				const double t = ( m - centre ) / phases_;
+				const double r = ( m - centre ) / ( centre + 0.5 );
+				const double w = bessel_i0( k_kaiser_8x * std::sqrt( std::max( 1.0 - r * r, 0.0 ) ) ) / norm;
+				h[ m ]         = ( t == 0.0 ? 1.0 : std::sin( pi * t ) / ( pi * t ) ) * w;
+			}
+
+			for ( int p = 0; p < phases_; ++p ) {
+				double sum = 0.0;
+				for ( int k = 0; k < taps_; ++k ) {
+					sum += h[ p + phases_ * k ];
+				}
+				for ( int k = 0; k < taps_; ++k ) {
+					h[ p + phases_ * k ] /= sum;
+				}
+			}
+		}
+
+		coefficients_.resize( static_cast< size_t >( taps_ * phases_ * 2 ) );
+		for ( int k = 0; k < taps_; ++k ) {
+			for ( int p = 0; p < phases_; ++p ) {
+				const float c             = static_cast< float >( h[ p + phases_ * k ] );
+				const size_t lane         = static_cast< size_t >( k * phases_ + p ) * 2;
+				coefficients_[ lane ]     = c;
+				coefficients_[ lane + 1 ] = c;
+			}
+		}
+	}
+
+	void true_peak_meter::reset( )
+	{
+		std::fill( history_.begin( ), history_.end( ), 0.0f );
+		peak_ = 0.0f;
+		max_  = 0.0f;
+	}
+
+	void true_peak_meter::process( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return;
+
+		const size_t kept   = static_cast< size_t >( taps_ - 1 );
+		const size_t stride = ( kept + k_block_frames ) * 2;
+		const int pairs     = ( channels + 1 ) / 2;
+
+		if ( channels != channels_ ) {
+			channels_ = channels;
+			history_.assign( stride * pairs, 0.0f );
+		}
+
+		const true_peak_pair_fn fn = get_true_peak_pair( phases_ );
+
+		peak_ = 0.0f;
+		for ( size_t offset = 0; offset < frame_count; offset += k_block_frames ) {
+			const size_t count = std::min( k_block_frames, frame_count - offset );
+
+			for ( int pair = 0; pair < pairs; ++pair ) {
+				// an odd last channel is paired with itself
+				const int a  = pair * 2;
+				const int b  = std::min( a + 1, channels - 1 );
+				float* frame = history_.data( ) + pair * stride;
+
+				const sample_t* src = samples + offset * channels;
+				for ( size_t i = 0; i < count; ++i ) {
+					frame[ ( kept + i ) * 2 ]     = src[ i * channels + a ];
+					frame[ ( kept + i ) * 2 + 1 ] = src[ i * channels + b ];
+				}
+
+				float peak[ 2 ] = { };
+				fn( frame, count, coefficients_.data( ), taps_, peak );
+				peak_ = std::max( { peak_, peak[ 0 ], peak[ 1 ] } );
+
+				std::memmove( frame, frame + count * 2, kept * 2 * sizeof( float ) );
+			}
+		}
+
+		max_ = std::max( max_, peak_ );
+	}
+
+	float true_peak_meter::get_peak_db( ) const
+	{
+		return ( peak_ > 1e-10f ) ? 20.0f * std::log10( peak_ ) : -100.0f;
+	}
+
+	float true_peak_meter::get_max_db( ) const
+	{
+		return ( max_ > 1e-10f ) ? 20.0f * std::log10( max_ ) : -100.0f;
+	}
+
+} // namespace pm
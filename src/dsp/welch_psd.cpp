@@ -0,0 +1,241 @@
+#include "welch_psd.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace pm
+{
+
+	struct welch_psd::impl {
+		std::shared_ptr< const fft_plan > plan;
+		std::shared_ptr< const fft_window_table > window;
+		double window_power = 1.0; // sum of w^2
+		double window_sum   = 1.0; // sum of w
+
+		std::vector< float > windowed;
+		std::vector< float > spectrum;
+		std::vector< float > scratch;
+	};
+
+	static float select_channel( const sample_t* frame, int channels, fft_channel channel )
+	{
+		const float l = frame[ 0 ];
+		const float r = ( channels >= 2 ) ? frame[ 1 ] : frame[ 0 ];
+
+		switch ( channel ) {
+		case fft_channel::left:
+			return l;
+		case fft_channel::right:
+			return r;
+		case fft_channel::mid:
+			return ( l + r ) * 0.5f;
+		case fft_channel::side:
+			return ( l - r ) * 0.5f;
+		}
+		return l;
+	}
+
+	welch_psd::welch_psd( size_t segment_size, fft_window_type window, float overlap ) : impl_( std::make_unique< impl >( ) )
+	{
+		configure( segment_size, window, overlap );
+	}
+
+	welch_psd::~welch_psd( ) = default;
+
+	void welch_psd::configure( size_t segment_size, fft_window_type window, float overlap )
+	{
+		segment_size_ = std::max< size_t >( segment_size, 16 );
+		window_type_  = window;
+		overlap_      = std::clamp( overlap, 0.0f, 0.9f );
+		hop_size_     = std::max< size_t >( static_cast< size_t >( std::lround( segment_size_ * ( 1.0 - overlap_ ) ) ), 1 );
+
+		impl_->plan   = fft_plan_cache::instance( ).get_plan( segment_size_ );
+		impl_->window = fft_plan_cache::instance( ).get_window( segment_size_, window_type_ );
+
+		impl_->window_power = 0.0;
+		impl_->window_sum   = 0.0;
+		for ( float w : *impl_->window ) {
+			impl_->window_power += static_cast< double >( w ) * w;
+			impl_->window_sum += w;
+		}
+
+		impl_->windowed.assign( segment_size_, 0.0f );
+		impl_->spectrum.assign( segment_size_ + 2, 0.0f );
+		impl_->scratch.assign( segment_size_, 0.0f );
+		history_.assign( segment_size_, 0.0f );
+
+		reset( );
+	}
+
+	void welch_psd::set_sample_rate( int sample_rate )
+	{
+		sample_rate_ = sample_rate;
+		reset( );
+	}
+
+	void welch_psd::set_channel( fft_channel channel )
+	{
+		channel_ = channel;
+		reset( );
+	}
+
+	void welch_psd::reset( )
+	{
+		power_sum_.assign( get_bin_count( ), 0.0 );
+		segments_ = 0;
+		fill_     = 0;
+	}
+
+	void welch_psd::add_segment( const float* segment )
+	{
+		const auto& window = *impl_->window;
+		for ( size_t i = 0; i < segment_size_; ++i ) {
+			impl_->windowed[ i ] = segment[ i ] * window[ i ];
+		}
+
+		impl_->plan->forward_real( impl_->windowed.data( ), impl_->spectrum.data( ), impl_->scratch.data( ) );
+
+		const float* bins = impl_->spectrum.data( );
+		for ( size_t k = 0; k < power_sum_.size( ); ++k ) {
+			const double re = bins[ k * 2 ];
+			const double im = bins[ k * 2 + 1 ];
+			power_sum_[ k ] += re * re + im * im;
+		}
+		segments_++;
+	}
+
+	void welch_psd::push( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return;
+
+		size_t offset = 0;
+		while ( offset < frame_count ) {
+			size_t count = std::min( frame_count - offset, segment_size_ - fill_ );
+			for ( size_t i = 0; i < count; ++i ) {
+				history_[ fill_ + i ] = select_channel( samples + ( offset + i ) * channels, channels, channel_ );
+			}
+			fill_ += count;
+			offset += count;
+
+			if ( fill_ == segment_size_ ) {
+				add_segment( history_.data( ) );
+
+				// keep the overlap, hops longer than the segment skip input
+				if ( hop_size_ < segment_size_ ) {
+					std::copy( history_.begin( ) + hop_size_, history_.end( ), history_.begin( ) );
+					fill_ = segment_size_ - hop_size_;
+				} else {
+					fill_ = 0;
+				}
+			}
+		}
+	}
+
+	void welch_psd::analyze( const sample_t* samples, size_t frame_count, int channels, size_t thread_count )
+	{
+		reset( );
+		if ( channels < 1 || frame_count < segment_size_ )
+			return;
+
+		const size_t total = ( frame_count - segment_size_ ) / hop_size_ + 1;
+
+		if ( thread_count == 0 ) {
+			thread_count = std::max< size_t >( std::thread::hardware_concurrency( ), 1 );
+		}
+		thread_count = std::min( thread_count, total );
+
+		// contiguous runs of segments, one accumulator per thread, merged in
+		// order so the result does not depend on scheduling
+		auto run = [ & ]( welch_psd& target, size_t first, size_t last ) {
+			std::vector< float > segment( segment_size_ );
+			for ( size_t s = first; s < last; ++s ) {
+				const sample_t* src = samples + s * hop_size_ * channels;
+				for ( size_t i = 0; i < segment_size_; ++i ) {
+					segment[ i ] = select_channel( src + i * channels, channels, channel_ );
+				}
+				target.add_segment( segment.data( ) );
+			}
+		};
+
+		std::vector< std::unique_ptr< welch_psd > > partials;
+		std::vector< std::thread > threads;
+		for ( size_t t = 1; t < thread_count; ++t ) {
+			partials.push_back( std::make_unique< welch_psd >( segment_size_, window_type_, overlap_ ) );
+			partials.back( )->sample_rate_ = sample_rate_;
+			partials.back( )->channel_     = channel_;
+
+			welch_psd* partial = partials.back( ).get( );
+			const size_t first = total * t / thread_count;
+			const size_t last  = total * ( t + 1 ) / thread_count;
+			threads.emplace_back( [ &run, partial, first, last ] { run( *partial, first, last ); } );
+		}
+
+		run( *this, 0, total / thread_count );
+
+		for ( auto& thread : threads ) {
+			thread.join( );
+		}
+		for ( const auto& partial : partials ) {
+			merge( *partial );
+		}
+	}
+
+	bool welch_psd::merge( const welch_psd& other )
+	{
+		if ( other.segment_size_ != segment_size_ || other.window_type_ != window_type_ || other.hop_size_ != hop_size_ ||
+		     other.sample_rate_ != sample_rate_ || other.channel_ != channel_ )
+			return false;
+
+		for ( size_t k = 0; k < power_sum_.size( ); ++k ) {
+			power_sum_[ k ] += other.power_sum_[ k ];
+		}
+		segments_ += other.segments_;
+		return true;
+	}
+
+	float welch_psd::get_resolution( ) const
+	{
+		const double enbw = static_cast< double >( segment_size_ ) * impl_->window_power / ( impl_->window_sum * impl_->window_sum );
+		return static_cast< float >( enbw * sample_rate_ / static_cast< double >( segment_size_ ) );
+	}
+
+	double welch_psd::get_psd( size_t bin ) const
+	{
+		if ( segments_ == 0 || bin >= power_sum_.size( ) )
+			return 0.0;
+
+		const bool edge    = ( bin == 0 || bin == segment_size_ / 2 );
+		const double scale = ( edge ? 1.0 : 2.0 ) / ( static_cast< double >( segments_ ) * sample_rate_ * impl_->window_power );
+		return power_sum_[ bin ] * scale;
+	}
+
+	void welch_psd::get_psd_db( float* output, float min_db ) const
+	{
+		for ( size_t k = 0; k < power_sum_.size( ); ++k ) {
+			const double psd = get_psd( k );
+			output[ k ]      = ( psd > 0.0 ) ? std::max( static_cast< float >( 10.0 * std::log10( psd ) ), min_db ) : min_db;
+		}
+	}
+
+	double welch_psd::get_band_power( float freq_start, float freq_end ) const
+	{
+		if ( segments_ == 0 || freq_end <= freq_start )
+			return 0.0;
+
+		// bin k covers [ ( k - 0.5 ) df, ( k + 0.5 ) df ), in bin units shifted by 0.5
+		const double df    = static_cast< double >( sample_rate_ ) / static_cast< double >( segment_size_ );
+		const double bins  = static_cast< double >( power_sum_.size( ) );
+		const double start = std::clamp( freq_start / df + 0.5, 0.0, bins );
+		const double end   = std::clamp( freq_end / df + 0.5, 0.0, bins );
+		double power       = 0.0;
+
+		for ( size_t k = static_cast< size_t >( start ); static_cast< double >( k ) < end; ++k ) {
+			const double lo = std::max( start, static_cast< double >( k ) );
+			const double hi = std::min( end, static_cast< double >( k + 1 ) );
+			power += get_psd( k ) * ( hi - lo ) * df;
+		}
+		return power;
+	}
+
+} // namespace pm
@@ -0,0 +1,103 @@
+#pragma once
+
+// Welch-averaged power spectral density for long-term average spectra
+
+#include "fft_processor.h"
+#include <memory>
+#include <vector>
+
+namespace pm
+{
+
+	// averages |X_k|^2 over overlapping windowed segments in double precision
+	// and normalises by the window power, so the result is a one-sided PSD in
+	// full-scale^2 / Hz that does not depend on segment size or window:
+	//   psd[ k ] = c_k * sum |X_k|^2 / ( segments * sample_rate * sum w^2 )
+	// with c_k = 2 except at DC and nyquist. state is one segment of history
+	// plus one sum per bin, so memory is fixed however long it runs.
+	// accumulators with the same configuration can be merged, which is how
+	// offline analysis spreads a file over several threads
+	class welch_psd
+	{
+	public:
+		explicit welch_psd( size_t segment_size = k_fft_size_4096, fft_window_type window = fft_window_type::hann, float overlap = 0.5f );
+		~welch_psd( );
+
+		welch_psd( const welch_psd& )            = delete;
+		welch_psd& operator=( const welch_psd& ) = delete;
+
+		// overlap is clamped to [0, 0.9]. any change resets the accumulation
+		void configure( size_t segment_size, fft_window_type window, float overlap );
+		void set_sample_rate( int sample_rate );
+		void set_channel( fft_channel channel );
+
+		// real time: interleaved samples in blocks of any size
+		void push( const sample_t* samples, size_t frame_count, int channels );
+
+		// offline: reset, then every full segment of the stream with the work
+		// split across threads (0 = hardware concurrency). same segments and
+		// result as reset( ) plus push( ), except that the trailing partial
+		// segment is dropped instead of kept as history
+		void analyze( const sample_t* samples, size_t frame_count, int channels, size_t thread_count = 0 );
+
+		// adds the other accumulator's segments. false, and nothing changes,
+		// when segment size, window, overlap, sample rate or channel differ
+		bool merge( const welch_psd& other );
+		void reset( );
+
+		size_t get_segment_count( ) const
+		{
+			return segments_;
+		}
+		size_t get_segment_size( ) const
+		{
+			return segment_size_;
+		}
+		size_t get_hop_size( ) const
+		{
+			return hop_size_;
+		}
+		size_t get_bin_count( ) const
+		{
+			return segment_size_ / 2 + 1;
+		}
+		float get_frequency( size_t bin ) const
+		{
+			return static_cast< float >( bin ) * static_cast< float >( sample_rate_ ) / static_cast< float >( segment_size_ );
+		}
+		// bin spacing times the window's equivalent noise bandwidth in bins
+		float get_resolution( ) const;
+
+		// full-scale^2 / Hz, 0 before the first segment
+		double get_psd( size_t bin ) const;
+
+		// 10 log10 of get_psd( ) for every bin, floored at min_db
+		void get_psd_db( float* output, float min_db = -200.0f ) const;
+
+		// integral of the PSD over [freq_start, freq_end), partial bins weighted.
+		// a sine of amplitude A integrates to A^2 / 2 over its main lobe
+		double get_band_power( float freq_start, float freq_end ) const;
+
+	private:
+		struct impl;
+		std::unique_ptr< impl > impl_;
+
+		size_t segment_size_;
+		size_t hop_size_;
+		fft_window_type window_type_;
+		float overlap_;
+		int sample_rate_     = k_default_sample_rate;
+		fft_channel channel_ = fft_channel::mid;
+
+		// sum of |X_k|^2 over all segments, get_bin_count( ) entries
+		std::vector< double > power_sum_;
+		size_t segments_ = 0;
+
+		// linear history, [0, fill_) valid
+		std::vector< float > history_;
+		size_t fill_ = 0;
+
+		void add_segment( const float* segment );
+	};
+
+} // namespace pm
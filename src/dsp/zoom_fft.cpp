@@ -0,0 +1,249 @@
+#include "zoom_fft.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace pm
+{
+
+	// frames mixed and decimated per inner iteration, bounds the scratch buffer
+	static constexpr size_t k_block_frames = 512;
+
+	// the half-band passband is flat to ~0.16 of its input rate, so after the
+	// last stage only +-0.32 of the output rate is clean
+	static constexpr float k_usable_fraction = 0.32f;
+
+	static constexpr size_t k_max_stages = 16;
+
+	zoom_fft::zoom_fft( size_t fft_size ) : fft_size_( fft_size ), hop_size_( fft_size / 4 ), block_( k_block_frames * 2 )
+	{
+		configure( );
+	}
+
+	void zoom_fft::set_band( float center_hz, float span_hz )
+	{
+		center_         = std::max( center_hz, 0.0f );
+		requested_span_ = std::max( span_hz, 1.0f );
+		configure( );
+	}
+
+	void zoom_fft::set_fft_size( size_t size )
+	{
+		fft_size_ = size;
+		hop_size_ = size / 4;
+		configure( );
+	}
+
+	void zoom_fft::set_sample_rate( int sample_rate )
+	{
+		sample_rate_ = sample_rate;
+		configure( );
+	}
+
+	void zoom_fft::set_channel( fft_channel channel )
+	{
+		channel_ = channel;
+		reset( );
+	}
+
+	void zoom_fft::set_window_type( fft_window_type type )
+	{
+		window_type_ = type;
+		window_      = fft_plan_cache::instance( ).get_window( fft_size_, window_type_ );
+		reset( );
+	}
+
+	void zoom_fft::configure( )
+	{
+		// halve the rate while the band still fits in the clean part
+		size_t stages = 0;
+		double rate   = static_cast< double >( sample_rate_ );
+		while ( stages < k_max_stages && rate * 0.5 * k_usable_fraction * 2.0 >= requested_span_ ) {
+			rate *= 0.5;
+			stages++;
+		}
+
+		decimators_.assign( stages, halfband_decimator( 2 ) );
+
+		const double pi = 3.14159265358979323846;
+		const double w  = 2.0 * pi * static_cast< double >( center_ ) / static_cast< double >( sample_rate_ );
+		step_re_        = std::cos( w );
+		step_im_        = -std::sin( w );
+
+		bin_count_ = static_cast< size_t >( k_usable_fraction * static_cast< float >( fft_size_ ) ) * 2 + 1;
+
+		plan_   = fft_plan_cache::instance( ).get_plan( fft_size_ );
+		window_ = fft_plan_cache::instance( ).get_window( fft_size_, window_type_ );
+		history_.assign( fft_size_ * 2, 0.0f );
+		frame_.assign( fft_size_ * 2, 0.0f );
+		spectrum_.assign( fft_size_ * 2, 0.0f );
+
+		reset( );
+	}
+
+	void zoom_fft::reset( )
+	{
+		for ( auto& decimator : decimators_ ) {
+			decimator.reset( );
+		}
+		osc_re_ = 1.0;
+		osc_im_ = 0.0;
+		fill_   = 0;
+		ready_  = false;
+		magnitudes_db_.assign( bin_count_, -100.0f );
+	}
+
+	size_t zoom_fft::push( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return 0;
+
+		size_t frames = 0;
+
+		for ( size_t offset = 0; offset < frame_count; offset += k_block_frames ) {
+			size_t count = std::min( k_block_frames, frame_count - offset );
+
+			// select the channel and mix down to baseband
+			for ( size_t i = 0; i < count; ++i ) {
+				const sample_t* src = samples + ( offset + i ) * channels;
+				const float l       = src[ 0 ];
+				const float r       = ( channels >= 2 ) ? src[ 1 ] : src[ 0 ];
+
+				float x = l;
+				switch ( channel_ ) {
+				case fft_channel::right:
+					x = r;
+					break;
+				case fft_channel::mid:
+					x = ( l + r ) * 0.5f;
+					break;
+				case fft_channel::side:
+					x = ( l - r ) * 0.5f;
+					break;
+				default:
+					break;
+				}
+
+				block_[ i * 2 ]     = static_cast< float >( x * osc_re_ );
+				block_[ i * 2 + 1 ] = static_cast< float >( x * osc_im_ );
+
+				const double re = osc_re_ * step_re_ - osc_im_ * step_im_;
+				osc_im_         = osc_re_ * step_im_ + osc_im_ * step_re_;
+				osc_re_         = re;
+			}
+
+			const double norm = 1.0 / std::sqrt( osc_re_ * osc_re_ + osc_im_ * osc_im_ );
+			osc_re_ *= norm;
+			osc_im_ *= norm;
+
+			for ( auto& decimator : decimators_ ) {
+				count = decimator.process( block_.data( ), count, block_.data( ) );
+			}
+
+			// append to the history, emitting a frame each time it fills
+			const float* src = block_.data( );
+			while ( count > 0 ) {
+				size_t take = std::min( count, fft_size_ - fill_ );
+				std::memcpy( history_.data( ) + fill_ * 2, src, take * 2 * sizeof( float ) );
+				fill_ += take;
+				src += take * 2;
+				count -= take;
+
+				if ( fill_ == fft_size_ ) {
+					emit_frame( );
+					frames++;
+
+					std::memmove( history_.data( ), history_.data( ) + hop_size_ * 2, ( fft_size_ - hop_size_ ) * 2 * sizeof( float ) );
+					fill_ = fft_size_ - hop_size_;
+				}
+			}
+		}
+
+		return frames;
+	}
+
+	void zoom_fft::emit_frame( )
+	{
+		const auto& window = *window_;
+		for ( size_t i = 0; i < fft_size_; ++i ) {
+			frame_[ i * 2 ]     = history_[ i * 2 ] * window[ i ];
+			frame_[ i * 2 + 1 ] = history_[ i * 2 + 1 ] * window[ i ];
+		}
+
+		plan_->forward_complex( frame_.data( ), spectrum_.data( ) );
+
+		// a real sine mixes down to half its amplitude, the same share the
+		// real transform puts in its positive bin, so fft_processor's 2 / N
+		// keeps the levels identical
+		const float scale = 2.0f / static_cast< float >( fft_size_ );
+		const size_t half = bin_count_ / 2;
+
+		for ( size_t b = 0; b < bin_count_; ++b ) {
+			// usable bin b is offset b - half from the centre, negative
+			// offsets wrap to the top of the transform
+			const size_t k = ( b + fft_size_ - half ) % fft_size_;
+			const float re = spectrum_[ k * 2 ];
+			const float im = spectrum_[ k * 2 + 1 ];
+			const float m  = std::sqrt( re * re + im * im ) * scale;
+
+			magnitudes_db_[ b ] = ( m > 1e-5f ) ? 20.0f * std::log10( m ) : -100.0f;
+		}
+
+		ready_ = true;
+	}
+
+	float zoom_fft::get_frequency( size_t bin ) const
+	{
+		const float offset = static_cast< float >( bin ) - static_cast< float >( bin_count_ / 2 );
+		return center_ + offset * get_resolution( );
+	}
+
+	float zoom_fft::get_band_magnitude_db( float freq_start, float freq_end ) const
+	{
+		if ( !ready_ )
+			return -100.0f;
+
+		const float first = get_frequency( 0 );
+		const float res   = get_resolution( );
+		const float last  = static_cast< float >( bin_count_ - 1 );
+
+		float lo = std::ceil( ( freq_start - first ) / res );
+		float hi = std::ceil( ( freq_end - first ) / res ) - 1.0f;
+		if ( hi < lo ) {
+			lo = hi = std::round( ( ( freq_start + freq_end ) * 0.5f - first ) / res );
+		}
+		if ( hi < 0.0f || lo > last )
+			return -100.0f;
+
+		const size_t begin = static_cast< size_t >( std::max( lo, 0.0f ) );
+		const size_t end   = static_cast< size_t >( std::min( hi, last ) ) + 1;
+		return *std::max_element( magnitudes_db_.begin( ) + begin, magnitudes_db_.begin( ) + end );
+	}
+
+	void zoom_fft::get_peak( float& frequency, float& db ) const
+	{
+		frequency = 0.0f;
+		db        = -100.0f;
+		if ( !ready_ )
+			return;
+
+		auto peak  = std::max_element( magnitudes_db_.begin( ), magnitudes_db_.end( ) );
+		size_t bin = static_cast< size_t >( peak - magnitudes_db_.begin( ) );
+
+		float offset = 0.0f;
+		db           = *peak;
+		if ( bin > 0 && bin + 1 < bin_count_ ) {
+			const float a     = magnitudes_db_[ bin - 1 ];
+			const float b     = magnitudes_db_[ bin ];
+			const float c     = magnitudes_db_[ bin + 1 ];
+			const float denom = a - 2.0f * b + c;
+			if ( denom < 0.0f ) {
+				offset = 0.5f * ( a - c ) / denom;
+				db     = b - 0.25f * ( a - c ) * offset;
+			}
+		}
+
+		frequency = get_frequency( bin ) + offset * get_resolution( );
+	}
+
+} // namespace pm
@@ -0,0 +1,121 @@
+#pragma once
+
+// zoom FFT: high-resolution spectrum of a narrow band around a centre frequency
+
+#include "fft_processor.h"
+#include "halfband_decimator.h"
+#include <memory>
+#include <vector>
+
+namespace pm
+{
+
+	// mixes the selected channel down so the centre frequency lands at 0 Hz,
+	// halves the rate with a cascade of half-band stages until the band only
+	// just fits, then runs a complex FFT at the reduced rate. resolution is
+	// sample_rate / ( 2^stages * fft_size ): a 200 Hz window at 48 kHz runs 7
+	// stages (375 Hz) and a 4096-point FFT for 0.09 Hz bins, where the direct
+	// route needs a 524288-point transform. cost is about two half-band stages
+	// at the input rate plus one small FFT per hop, memory is one frame.
+	// a frame covers fft_size / output rate seconds (~11 s for the example),
+	// which is the price of the resolution, not of the method
+	class zoom_fft
+	{
+	public:
+		explicit zoom_fft( size_t fft_size = k_fft_size_4096 );
+
+		// span is the minimum usable width, get_span( ) returns the actual one.
+		// any change resets the analysis
+		void set_band( float center_hz, float span_hz );
+		void set_fft_size( size_t size );
+		void set_sample_rate( int sample_rate );
+		void set_channel( fft_channel channel );
+		void set_window_type( fft_window_type type );
+
+		// push interleaved samples, returns the number of frames completed
+		size_t push( const sample_t* samples, size_t frame_count, int channels );
+		void reset( );
+
+		float get_center( ) const
+		{
+			return center_;
+		}
+		float get_span( ) const
+		{
+			return get_resolution( ) * static_cast< float >( bin_count_ - 1 );
+		}
+		float get_resolution( ) const
+		{
+			return get_output_rate( ) / static_cast< float >( fft_size_ );
+		}
+		float get_output_rate( ) const
+		{
+			return static_cast< float >( sample_rate_ ) / static_cast< float >( size_t( 1 ) << decimators_.size( ) );
+		}
+		size_t get_fft_size( ) const
+		{
+			return fft_size_;
+		}
+
+		// false until the first frame after a reset
+		bool is_ready( ) const
+		{
+			return ready_;
+		}
+
+		// usable bins only, ascending frequency, bin 0 at get_frequency( 0 )
+		size_t get_bin_count( ) const
+		{
+			return bin_count_;
+		}
+		float get_frequency( size_t bin ) const;
+		const std::vector< float >& get_magnitudes_db( ) const
+		{
+			return magnitudes_db_;
+		}
+
+		// loudest bin in [freq_start, freq_end), or the nearest bin when the
+		// range is narrower than one. peak rather than mean power, so a line
+		// keeps its level when a display band spans many bins
+		float get_band_magnitude_db( float freq_start, float freq_end ) const;
+
+		// loudest bin, parabolic interpolation on the dB values
+		void get_peak( float& frequency, float& db ) const;
+
+	private:
+		size_t fft_size_;
+		size_t hop_size_;
+		int sample_rate_             = k_default_sample_rate;
+		float center_                = 1000.0f;
+		float requested_span_        = 200.0f;
+		fft_channel channel_         = fft_channel::left;
+		fft_window_type window_type_ = fft_window_type::hann;
+		size_t bin_count_            = 0;
+		bool ready_                  = false;
+
+		// e^{-jwn}, advanced one sample at a time in double and renormalised
+		// every block so the magnitude never drifts
+		double osc_re_  = 1.0;
+		double osc_im_  = 0.0;
+		double step_re_ = 1.0;
+		double step_im_ = 0.0;
+
+		// complex ( re, im ) pairs, two channels as far as the decimators see
+		std::vector< halfband_decimator > decimators_;
+		std::vector< float > block_;
+
+		// decimated history, [0, fill_) complex samples valid
+		std::vector< float > history_;
+		size_t fill_ = 0;
+
+		std::shared_ptr< const fft_plan > plan_;
+		std::shared_ptr< const fft_window_table > window_;
+		std::vector< float > frame_;
+		std::vector< float > spectrum_;
+		std::vector< float > magnitudes_db_;
+
+		void configure( );
+		void emit_frame( );
+	};
+
+} // namespace pm
@@ -9,9 +9,23 @@ namespace pm
 
 	void layout_manager::add_meter( std::shared_ptr< meter_panel > meter )
 	{
+		if ( sample_rate_ > 0 ) {
+			meter->set_sample_rate( sample_rate_ );
+		}
 		meters_.push_back( std::move( meter ) );
 	}
 
+	void layout_manager::set_sample_rate( int sample_rate )
+	{
+		if ( sample_rate == sample_rate_ || sample_rate <= 0 )
+			return;
+
+		sample_rate_ = sample_rate;
+		for ( auto& meter : meters_ ) {
+			meter->set_sample_rate( sample_rate );
+		}
+	}
+
 	void layout_manager::remove_meter( const char* name )
 	{
 		meters_.erase( std::remove_if( meters_.begin( ), meters_.end( ), [ name ]( const auto& m ) { return strcmp( m->get_name( ), name ) == 0; } ),
@@ -35,8 +49,11 @@ namespace pm
 
 	void layout_manager::update_all( const sample_t* samples, size_t frame_count, int channels )
 	{
+		compute_level_stats( samples, frame_count, channels, levels_ );
+
 		for ( auto& meter : meters_ ) {
 			if ( meter->is_visible( ) ) {
+				meter->update_levels( levels_ );
 				meter->update( samples, frame_count, channels );
 			}
 		}
@@ -51,6 +51,15 @@ namespace pm
 		// update all meters with audio data
 		void update_all( const sample_t* samples, size_t frame_count, int channels );
 
+		// per-channel statistics of the last update_all( ) block
+		const level_stats& get_levels( ) const
+		{
+			return levels_;
+		}
+
+		// forwards a changed capture rate to every meter, visible or not
+		void set_sample_rate( int sample_rate );
+
 		// render all visible meters according to current layout
 		void render_all( );
 
@@ -66,6 +75,8 @@ namespace pm
 	private:
 		layout_mode mode_ = layout_mode::quad;
 		std::vector< std::shared_ptr< meter_panel > > meters_;
+		level_stats levels_;
+		int sample_rate_ = 0; // 0 until the first set_sample_rate( )
 		float stick_height_ = 80.0f;
 
 		void render_horizontal_bar( );
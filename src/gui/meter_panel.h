@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common/types.h"
+#include "../dsp/level_stats.h"
 #include "imgui.h"
 #include <string>
 
@@ -20,6 +21,14 @@ namespace pm
 		// update meter with new audio samples
 		virtual void update( const sample_t* samples, size_t frame_count, int channels ) = 0;
 
+		// per-channel peak/RMS of the same block, measured once for all meters.
+		// called before update( )
+		virtual void update_levels( const level_stats& ) { }
+
+		// capture sample rate, called before the first update( ) and whenever
+		// the device changes it
+		virtual void set_sample_rate( int ) { }
+
 		// render the meter visualization
 		virtual void render( ) = 0;
 
@@ -5,38 +5,29 @@
 namespace pm
 {
 
-	loudness_meter::loudness_meter( ) : meter_panel( "Loudness" ) { }
+	loudness_meter::loudness_meter( ) : meter_panel( "Loudness" )
+	{
+		// 20ms steps, so momentary/short-term move smoothly at display rate
+		lufs_.set_refresh_rate( 50 );
+	}
 
-	void loudness_meter::update( const sample_t* samples, size_t frame_count, int channels )
+	void loudness_meter::update_levels( const level_stats& levels )
 	{
-		if ( channels < 1 )
+		if ( levels.channels < 1 )
 			return;
 
-		// calculate peak and RMS for each channel
-		float max_l = 0.0f, max_r = 0.0f;
-		float sum_l = 0.0f, sum_r = 0.0f;
-
-		for ( size_t i = 0; i < frame_count; ++i ) {
-			float l = std::abs( samples[ i * channels ] );
-			max_l   = std::max( max_l, l );
-			sum_l += l * l;
-
-			if ( channels >= 2 ) {
-				float r = std::abs( samples[ i * channels + 1 ] );
-				max_r   = std::max( max_r, r );
-				sum_r += r * r;
-			} else {
-				max_r = max_l;
-				sum_r = sum_l;
-			}
-		}
+		// peak and RMS for each channel, mono feeds both sides
+		const int right = ( levels.channels >= 2 ) ? 1 : 0;
+
+		float max_l = levels.get_peak( 0 );
+		float max_r = levels.get_peak( right );
 
 		// convert to dB
 		peak_l_ = ( max_l > 1e-10f ) ? 20.0f * std::log10( max_l ) : -100.0f;
 		peak_r_ = ( max_r > 1e-10f ) ? 20.0f * std::log10( max_r ) : -100.0f;
 
-		float rms_val_l = std::sqrt( sum_l / frame_count );
-		float rms_val_r = std::sqrt( sum_r / frame_count );
+		float rms_val_l = levels.get_rms( 0 );
+		float rms_val_r = levels.get_rms( right );
 		rms_l_          = ( rms_val_l > 1e-10f ) ? 20.0f * std::log10( rms_val_l ) : -100.0f;
 		rms_r_          = ( rms_val_r > 1e-10f ) ? 20.0f * std::log10( rms_val_r ) : -100.0f;
 
@@ -79,11 +70,26 @@ namespace pm
 			rms_slow_sum_   = 0.0f;
 			rms_slow_count_ = 0;
 		}
+	}
 
-		// LUFS processing
-		if ( channels >= 2 ) {
-			lufs_.process( samples, frame_count );
-		}
+	void loudness_meter::set_sample_rate( int sample_rate )
+	{
+		// K-weighting coefficients and block lengths follow the rate. starts
+		// a new measurement, as a device change does anyway
+		lufs_.set_sample_rate( sample_rate );
+		true_peak_.reset( );
+	}
+
+	void loudness_meter::update( const sample_t* samples, size_t frame_count, int channels )
+	{
+		if ( channels < 1 )
+			return;
+
+		// LUFS processing, every channel with its BS.1770 weight
+		lufs_.process( samples, frame_count, channels );
+
+		// true peak, every channel
+		true_peak_.process( samples, frame_count, channels );
 	}
 
 	float loudness_meter::get_display_value( ) const
@@ -178,11 +184,26 @@ namespace pm
 		snprintf( peak_text, sizeof( peak_text ), "Peak: %.1f dB", peak_hold_ );
 		draw_list->AddText( ImVec2( value_pos.x, value_pos.y + 60.0f ), IM_COL32( 200, 200, 200, 255 ), peak_text );
 
-		// draw integrated LUFS if in LUFS mode
+		// draw true peak max hold, red above the -1 dBTP broadcast ceiling
+		const float true_peak = true_peak_.get_max_db( );
+		char true_peak_text[ 32 ];
+		if ( true_peak <= -100.0f ) {
+			snprintf( true_peak_text, sizeof( true_peak_text ), "TP: -inf dBTP" );
+		} else {
+			snprintf( true_peak_text, sizeof( true_peak_text ), "TP: %.1f dBTP", true_peak );
+		}
+		ImU32 true_peak_color = ( true_peak > -1.0f ) ? IM_COL32( 255, 80, 80, 255 ) : IM_COL32( 200, 200, 200, 255 );
+		draw_list->AddText( ImVec2( value_pos.x, value_pos.y + 80.0f ), true_peak_color, true_peak_text );
+
+		// draw integrated LUFS and loudness range if in LUFS mode
 		if ( mode_ == loudness_mode::lufs_momentary || mode_ == loudness_mode::lufs_short ) {
 			char int_text[ 32 ];
 			snprintf( int_text, sizeof( int_text ), "Int: %.1f LUFS", lufs_.get_integrated( ) );
-			draw_list->AddText( ImVec2( value_pos.x, value_pos.y + 80.0f ), IM_COL32( 180, 180, 180, 255 ), int_text );
+			draw_list->AddText( ImVec2( value_pos.x, value_pos.y + 100.0f ), IM_COL32( 180, 180, 180, 255 ), int_text );
+
+			char lra_text[ 32 ];
+			snprintf( lra_text, sizeof( lra_text ), "LRA: %.1f LU", lufs_.get_loudness_range( ) );
+			draw_list->AddText( ImVec2( value_pos.x, value_pos.y + 120.0f ), IM_COL32( 180, 180, 180, 255 ), lra_text );
 		}
 
 		// advance cursor
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../dsp/loudness.h"
+#include "../dsp/true_peak.h"
 #include "../gui/meter_panel.h"
 
 namespace pm
@@ -19,6 +20,8 @@ namespace pm
 		loudness_meter( );
 
 		void update( const sample_t* samples, size_t frame_count, int channels ) override;
+		void update_levels( const level_stats& levels ) override;
+		void set_sample_rate( int sample_rate ) override;
 		void render( ) override;
 
 		void set_mode( loudness_mode mode )
@@ -28,6 +31,7 @@ namespace pm
 
 	private:
 		lufs_meter lufs_;
+		true_peak_meter true_peak_;
 		loudness_mode mode_ = loudness_mode::lufs_momentary;
 
 		float peak_l_ = -100.0f;
@@ -5,92 +5,106 @@
 namespace pm
 {
 
-	spectrogram::spectrogram( ) : meter_panel( "Spectrogram" ), fft_( k_fft_size_2048 )
+	// convert display row (0 to k_display_rows-1) to frequency using logarithmic scale
+	static float row_to_freq( int row, int total_rows )
+	{
+		float t = static_cast< float >( row ) / ( total_rows - 1 );
+		return k_min_freq * std::pow( k_max_freq / k_min_freq, t );
+	}
+
+	spectrogram::spectrogram( ) : meter_panel( "Spectrogram" ), stft_( k_fft_size_2048, k_fft_size_2048 / 2, stft_input::mono ),
+	      multires_( k_fft_size_2048, 5, stft_input::mono )
 	{
-		mono_buffer_.resize( k_fft_size_2048 );
+		stft_.reserve( k_fft_size_16384 );
+		stft_.get_processor( ).set_smoothing( 0.0f );
+		stft_.set_frame_callback( [ this ]( const fft_processor& fft ) { on_frame( fft ); } );
+		multires_.set_frame_callback( [ this ]( const multires_analyzer& analyzer ) { on_multires_frame( analyzer ); } );
 
 		// initialize history
 		history_.resize( k_history_width );
 		for ( auto& col : history_ ) {
 			col.resize( k_display_rows, -100.0f );
 		}
+
+		// fixed log axis, only the bin tables depend on fft size / sample rate
+		row_start_.resize( k_display_rows );
+		row_end_.resize( k_display_rows );
+		for ( int row = 0; row < k_display_rows; ++row ) {
+			row_start_[ row ] = row_to_freq( row, k_display_rows );
+			row_end_[ row ]   = row_to_freq( row + 1, k_display_rows );
+		}
 	}
 
 	void spectrogram::set_fft_size( size_t size )
 	{
-		fft_.set_fft_size( size );
-		mono_buffer_.resize( size );
+		// keep the same overlap ratio, and the multi-resolution stages at the
+		// same size relative to the single stream
+		size_t hop           = stft_.get_hop_size( ) * size / stft_.get_fft_size( );
+		size_t multires_size = multires_.get_fft_size( ) * size / stft_.get_fft_size( );
+		stft_.set_fft_size( size );
+		stft_.set_hop_size( hop );
+		multires_.set_fft_size( multires_size );
 	}
 
-	// convert display row (0 to k_display_rows-1) to frequency using logarithmic scale
-	static float row_to_freq( int row, int total_rows )
+	void spectrogram::set_sample_rate( int sample_rate )
 	{
-		float t = static_cast< float >( row ) / ( total_rows - 1 );
-		return k_min_freq * std::pow( k_max_freq / k_min_freq, t );
+		// row bin tables are rebuilt on the next frame, hops stay in samples
+		stft_.set_sample_rate( sample_rate );
+		stft_.reset( );
+		multires_.set_sample_rate( sample_rate );
+		averager_.reset( );
 	}
 
-	// convert frequency to FFT bin index
-	static size_t freq_to_bin( float freq, size_t bin_count, float sample_rate )
+	void spectrogram::update( const sample_t* samples, size_t frame_count, int channels )
 	{
-		float bin_width = sample_rate / ( bin_count * 2.0f );
-		size_t bin      = static_cast< size_t >( freq / bin_width );
-		return std::min( bin, bin_count - 1 );
+		// emits one frame callback per hop, independent of chunk size and frame rate
+		if ( source_ == spectrum_source::multi_resolution ) {
+			multires_.push( samples, frame_count, channels );
+		} else {
+			stft_.push( samples, frame_count, channels );
+		}
 	}
 
-	// get averaged magnitude for a frequency range
-	static float get_band_db( const fft_processor& fft, float freq_start, float freq_end )
+	float* spectrogram::advance_column( )
 	{
-		size_t bin_count  = fft.get_bin_count( );
-		float sample_rate = static_cast< float >( fft.get_sample_rate( ) );
-
-		size_t bin_start = freq_to_bin( freq_start, bin_count, sample_rate );
-		size_t bin_end   = freq_to_bin( freq_end, bin_count, sample_rate );
-
-		if ( bin_start >= bin_end )
-			bin_end = bin_start + 1;
-		if ( bin_end > bin_count )
-			bin_end = bin_count;
-
-		float sum = 0.0f;
-		for ( size_t i = bin_start; i < bin_end; ++i ) {
-			float mag = fft.get_magnitude( i );
-			sum += mag * mag;
-		}
+		update_counter_++;
+		if ( update_counter_ < updates_per_column_ )
+			return nullptr;
 
-		float avg_power = sum / ( bin_end - bin_start );
-		float avg_mag   = std::sqrt( avg_power );
+		update_counter_ = 0;
 
-		return ( avg_mag > 1e-10f ) ? 20.0f * std::log10( avg_mag ) : -100.0f;
+		float* col = history_[ write_pos_ ].data( );
+		write_pos_ = ( write_pos_ + 1 ) % k_history_width;
+		return col;
 	}
 
-	void spectrogram::update( const sample_t* samples, size_t frame_count, int channels )
+	void spectrogram::on_frame( const fft_processor& fft )
 	{
-		// convert to mono
-		size_t copy_count = std::min( frame_count, mono_buffer_.size( ) );
-		for ( size_t i = 0; i < copy_count; ++i ) {
-			if ( channels >= 2 ) {
-				mono_buffer_[ i ] = ( samples[ i * channels ] + samples[ i * channels + 1 ] ) * 0.5f;
-			} else if ( channels >= 1 ) {
-				mono_buffer_[ i ] = samples[ i * channels ];
-			}
-		}
+		// average every frame, even the ones that do not produce a column
+		const auto& mags = fft.get_magnitudes( );
+		averager_.process( mags.data( ), mags.size( ), 1.0f / stft_.get_frame_rate( ) );
 
-		fft_.process( mono_buffer_.data( ), copy_count );
+		float* col = advance_column( );
+		if ( !col )
+			return;
 
-		update_counter_++;
-		if ( update_counter_ >= updates_per_column_ ) {
-			update_counter_ = 0;
+		if ( !row_map_.is_built_for( fft.get_fft_size( ), fft.get_sample_rate( ) ) ) {
+			row_map_.build( row_start_.data( ), row_end_.data( ), k_display_rows, fft.get_fft_size( ), fft.get_sample_rate( ) );
+		}
 
-			// store FFT magnitudes in history (with proper frequency mapping)
-			auto& col = history_[ write_pos_ ];
+		// store FFT magnitudes in history (with proper frequency mapping)
+		row_map_.reduce_db( averager_.get_magnitudes( ).data( ), -100.0f, col );
+	}
 
-			for ( int row = 0; row < k_display_rows; ++row ) {
-				float freq      = row_to_freq( row, k_display_rows );
-				float freq_next = row_to_freq( row + 1, k_display_rows );
-				col[ row ]      = get_band_db( fft_, freq, freq_next );
-			}
+	void spectrogram::on_multires_frame( const multires_analyzer& analyzer )
+	{
+		float* col = advance_column( );
+		if ( !col )
+			return;
 
-			write_pos_ = ( write_pos_ + 1 ) % k_history_width;
+		// low rows come from the decimated stages, so they stay separated
+		for ( int row = 0; row < k_display_rows; ++row ) {
+			col[ row ] = analyzer.get_band_magnitude_db( row_start_[ row ], row_end_[ row ] );
 		}
 	}
 
@@ -1,6 +1,9 @@
 #pragma once
 
-#include "../dsp/fft_processor.h"
+#include "../dsp/band_map.h"
+#include "../dsp/multires_analyzer.h"
+#include "../dsp/spectral_averager.h"
+#include "../dsp/stft.h"
 #include "../gui/meter_panel.h"
 #include <vector>
 
@@ -13,9 +16,19 @@ namespace pm
 		spectrogram( );
 
 		void update( const sample_t* samples, size_t frame_count, int channels ) override;
+		void set_sample_rate( int sample_rate ) override;
 		void render( ) override;
 
 		void set_fft_size( size_t size );
+		void set_source( spectrum_source source )
+		{
+			source_ = source;
+		}
+		void set_averaging( const averaging_settings& settings )
+		{
+			averager_.configure( settings );
+			multires_.set_time_constant( settings.time_ms );
+		}
 		void set_min_db( float db )
 		{
 			min_db_ = db;
@@ -29,8 +42,16 @@ namespace pm
 		static constexpr size_t k_history_width = 256;
 		static constexpr int k_display_rows     = 128;
 
-		fft_processor fft_;
-		std::vector< sample_t > mono_buffer_;
+		// mono 2048-point frames every 1024 samples, one column per frame
+		stft stft_;
+
+		// raw stft frames are averaged here, in real time units
+		spectral_averager averager_;
+
+		// 2048-point stages, hop 1024 on the full-rate stage, so the column
+		// rate matches stft_
+		multires_analyzer multires_;
+		spectrum_source source_ = spectrum_source::fft;
 
 		// 2D array of dB values [time][frequency]
 		std::vector< std::vector< float > > history_;
@@ -42,6 +63,15 @@ namespace pm
 		size_t update_counter_     = 0;
 		size_t updates_per_column_ = 1;
 
+		// row edges in Hz and the bin table for the current fft size
+		std::vector< float > row_start_;
+		std::vector< float > row_end_;
+		band_map row_map_;
+
+		void on_frame( const fft_processor& fft );
+		void on_multires_frame( const multires_analyzer& analyzer );
+		// next history column to fill, or nullptr while skipping frames
+		float* advance_column( );
 		ImU32 db_to_color( float db );
 	};
 
@@ -6,61 +6,128 @@
 namespace pm
 {
 
-	spectrum::spectrum( ) : meter_panel( "Spectrum" ), fft_( k_fft_size_4096 )
+	spectrum::spectrum( ) : meter_panel( "Spectrum" ), stft_( k_fft_size_4096, k_fft_size_4096 / 4 )
 	{
-		left_buffer_.resize( k_fft_size_4096 );
-		right_buffer_.resize( k_fft_size_4096 );
+		stft_.reserve( k_fft_size_16384 );
+
+		// smoothing lives in averager_, the processor publishes raw frames
+		stft_.get_processor( ).set_smoothing( 0.0f );
+		averager_.set_peak_tracking( true );
+		stft_.set_frame_callback( [ this ]( const fft_processor& fft ) {
+			const auto& mags = fft.get_magnitudes( get_fft_channel( ) );
+			averager_.process( mags.data( ), mags.size( ), 1.0f / stft_.get_frame_rate( ) );
+			update_pitch( );
+		} );
+		pitch_input_.reserve( k_fft_size_16384 );
+
+		zoom_.set_band( ( zoom_start_ + zoom_end_ ) * 0.5f, zoom_end_ - zoom_start_ );
+	}
+
+	void spectrum::set_zoom( bool enabled )
+	{
+		if ( enabled && !zoom_enabled_ ) {
+			zoom_.reset( );
+		}
+		zoom_enabled_ = enabled;
+		bands_dirty_  = true;
+	}
+
+	void spectrum::set_zoom_window( float center_hz, float span_hz )
+	{
+		span_hz     = std::max( span_hz, 1.0f );
+		center_hz   = std::max( center_hz, span_hz * 0.5f );
+		zoom_start_ = center_hz - span_hz * 0.5f;
+		zoom_end_   = center_hz + span_hz * 0.5f;
+		zoom_.set_band( center_hz, span_hz );
+		bands_dirty_ = true;
 	}
 
 	void spectrum::set_fft_size( size_t size )
 	{
-		fft_.set_fft_size( size );
-		left_buffer_.resize( size );
-		right_buffer_.resize( size );
+		// keep the same overlap ratio, and the multi-resolution stages at the
+		// same size relative to the single stream
+		size_t hop           = stft_.get_hop_size( ) * size / stft_.get_fft_size( );
+		size_t multires_size = multires_.get_fft_size( ) * size / stft_.get_fft_size( );
+		stft_.set_fft_size( size );
+		stft_.set_hop_size( hop );
+		multires_.set_fft_size( multires_size );
+	}
+
+	void spectrum::set_sample_rate( int sample_rate )
+	{
+		// bin frequencies, the multi-resolution stage rates, the zoom mixer
+		// and the pitch lag-to-Hz conversion follow the rate, hops stay in
+		// samples. history captured at the old rate is dropped
+		stft_.set_sample_rate( sample_rate );
+		stft_.reset( );
+		multires_.set_sample_rate( sample_rate );
+		zoom_.set_sample_rate( sample_rate );
+		pitch_.set_sample_rate( sample_rate );
+		pitch_.reset( );
+		averager_.reset( );
+		bands_dirty_ = true;
 	}
 
 	void spectrum::update( const sample_t* samples, size_t frame_count, int channels )
 	{
-		size_t copy_count = std::min( frame_count, left_buffer_.size( ) );
-
-		// extract channels
-		for ( size_t i = 0; i < copy_count; ++i ) {
-			float l            = ( channels >= 1 ) ? samples[ i * channels ] : 0.0f;
-			float r            = ( channels >= 2 ) ? samples[ i * channels + 1 ] : l;
-			left_buffer_[ i ]  = l;
-			right_buffer_[ i ] = r;
+		// one complex FFT per hop yields L, R, M and S, so switching channel is free
+		if ( zoom_enabled_ ) {
+			zoom_.push( samples, frame_count, channels );
+		} else if ( source_ == spectrum_source::multi_resolution ) {
+			multires_.push( samples, frame_count, channels );
+		} else {
+			stft_.push( samples, frame_count, channels );
 		}
+	}
 
-		// select channel to process
-		std::vector< sample_t >* buffer = &left_buffer_;
+	fft_channel spectrum::get_fft_channel( ) const
+	{
 		switch ( channel_ ) {
 		case spectrum_channel::left:
-			buffer = &left_buffer_;
-			break;
+			return fft_channel::left;
 		case spectrum_channel::right:
-			buffer = &right_buffer_;
-			break;
+			return fft_channel::right;
 		case spectrum_channel::mid:
-			for ( size_t i = 0; i < copy_count; ++i ) {
-				left_buffer_[ i ] = ( left_buffer_[ i ] + right_buffer_[ i ] ) * 0.5f;
-			}
-			buffer = &left_buffer_;
-			break;
+			return fft_channel::mid;
 		case spectrum_channel::side:
-			for ( size_t i = 0; i < copy_count; ++i ) {
-				left_buffer_[ i ] = ( left_buffer_[ i ] - right_buffer_[ i ] ) * 0.5f;
-			}
-			buffer = &left_buffer_;
-			break;
+			return fft_channel::side;
 		}
+		return fft_channel::left;
+	}
+
+	void spectrum::update_pitch( )
+	{
+		const sample_t* left  = stft_.get_frame_left( );
+		const sample_t* right = stft_.get_frame_right( );
+		const size_t size     = stft_.get_fft_size( );
 
-		fft_.process( buffer->data( ), copy_count );
+		switch ( channel_ ) {
+		case spectrum_channel::left:
+			pitch_.process( left, size );
+			return;
+		case spectrum_channel::right:
+			pitch_.process( right, size );
+			return;
+		case spectrum_channel::mid:
+		case spectrum_channel::side: {
+			const float sign = ( channel_ == spectrum_channel::mid ) ? 1.0f : -1.0f;
+			pitch_input_.resize( size );
+			for ( size_t i = 0; i < size; ++i ) {
+				pitch_input_[ i ] = ( left[ i ] + sign * right[ i ] ) * 0.5f;
+			}
+			pitch_.process( pitch_input_.data( ), pitch_input_.size( ) );
+			return;
+		}
+		}
 	}
 
 	float spectrum::position_to_freq( float pos ) const
 	{
 		pos = std::max( 0.0f, std::min( 1.0f, pos ) );
 
+		if ( zoom_enabled_ )
+			return zoom_start_ + pos * ( zoom_end_ - zoom_start_ );
+
 		switch ( scale_ ) {
 		case spectrum_scale::linear:
 			return k_min_freq + pos * ( k_max_freq - k_min_freq );
@@ -81,6 +148,9 @@ namespace pm
 
 	float spectrum::freq_to_position( float freq ) const
 	{
+		if ( zoom_enabled_ )
+			return std::max( 0.0f, std::min( 1.0f, ( freq - zoom_start_ ) / ( zoom_end_ - zoom_start_ ) ) );
+
 		freq = std::max( k_min_freq, std::min( k_max_freq, freq ) );
 
 		switch ( scale_ ) {
@@ -100,33 +170,64 @@ namespace pm
 		return 0.0f;
 	}
 
-	float spectrum::get_band_magnitude_db( float freq_start, float freq_end ) const
+	void spectrum::update_band_maps( )
 	{
-		size_t bin_count  = fft_.get_bin_count( );
-		float sample_rate = static_cast< float >( fft_.get_sample_rate( ) );
-		float bin_width   = sample_rate / ( bin_count * 2.0f );
+		const fft_processor& fft = stft_.get_processor( );
+		size_t fft_size          = fft.get_fft_size( );
+		int sample_rate          = fft.get_sample_rate( );
+
+		if ( !bands_dirty_ && bar_map_.is_built_for( fft_size, sample_rate ) && band_scale_ == scale_ )
+			return;
 
-		size_t bin_start = static_cast< size_t >( freq_start / bin_width );
-		size_t bin_end   = static_cast< size_t >( freq_end / bin_width );
+		band_scale_  = scale_;
+		bands_dirty_ = false;
 
-		bin_start = std::min( bin_start, bin_count - 1 );
-		bin_end   = std::min( bin_end, bin_count );
+		bar_start_.resize( k_bar_count );
+		bar_end_.resize( k_bar_count );
+		bar_db_.resize( k_bar_count );
+		for ( size_t i = 0; i < k_bar_count; ++i ) {
+			bar_start_[ i ] = position_to_freq( static_cast< float >( i ) / k_bar_count );
+			bar_end_[ i ]   = position_to_freq( static_cast< float >( i + 1 ) / k_bar_count );
+		}
+
+		line_start_.resize( k_line_points );
+		line_end_.resize( k_line_points );
+		line_db_.resize( k_line_points );
+		for ( size_t i = 0; i < k_line_points; ++i ) {
+			float t          = static_cast< float >( i ) / ( k_line_points - 1 );
+			line_start_[ i ] = position_to_freq( t );
+			line_end_[ i ]   = position_to_freq( t + 1.0f / k_line_points );
+		}
 
-		if ( bin_start >= bin_end )
-			bin_end = bin_start + 1;
-		if ( bin_end > bin_count )
-			bin_end = bin_count;
+		bar_map_.build( bar_start_.data( ), bar_end_.data( ), k_bar_count, fft_size, sample_rate );
+		line_map_.build( line_start_.data( ), line_end_.data( ), k_line_points, fft_size, sample_rate );
+	}
 
-		float sum = 0.0f;
-		for ( size_t i = bin_start; i < bin_end; ++i ) {
-			float mag = fft_.get_magnitude( i );
-			sum += mag * mag;
+	void spectrum::reduce_bands( band_map& map, const std::vector< float >& start, const std::vector< float >& end, std::vector< float >& band_db )
+	{
+		if ( zoom_enabled_ ) {
+			for ( size_t i = 0; i < band_db.size( ); ++i ) {
+				band_db[ i ] = zoom_.get_band_magnitude_db( start[ i ], end[ i ] );
+			}
+			return;
 		}
 
-		float avg_power = sum / std::max( 1.0f, static_cast< float >( bin_end - bin_start ) );
-		float avg_mag   = std::sqrt( avg_power );
+		if ( source_ == spectrum_source::multi_resolution ) {
+			// each band may come from a different stage, no single table applies
+			for ( size_t i = 0; i < band_db.size( ); ++i ) {
+				band_db[ i ] = multires_.get_band_magnitude_db( start[ i ], end[ i ], get_fft_channel( ) );
+			}
+			return;
+		}
 
-		return ( avg_mag > 1e-10f ) ? 20.0f * std::log10( avg_mag ) : -100.0f;
+		const auto& mags = averager_.get_magnitudes( );
+		if ( mags.size( ) != stft_.get_processor( ).get_bin_count( ) ) {
+			// nothing averaged at this size yet
+			std::fill( band_db.begin( ), band_db.end( ), -100.0f );
+			return;
+		}
+
+		map.reduce_db( mags.data( ), -100.0f, band_db.data( ) );
 	}
 
 	void spectrum::find_peak( ImVec2 pos, ImVec2 size )
@@ -134,15 +235,18 @@ namespace pm
 		peak_.db        = -100.0f;
 		peak_.frequency = 0.0f;
 
-		size_t bin_count  = fft_.get_bin_count( );
-		float sample_rate = static_cast< float >( fft_.get_sample_rate( ) );
+		fft_channel channel = get_fft_channel( );
 
-		for ( size_t i = 1; i < bin_count; ++i ) {
-			float db = fft_.get_magnitude_db( i );
-			if ( db > peak_.db ) {
-				peak_.db        = db;
-				peak_.frequency = fft_.get_frequency( i );
-			}
+		if ( zoom_enabled_ ) {
+			zoom_.get_peak( peak_.frequency, peak_.db );
+		} else if ( source_ == spectrum_source::multi_resolution ) {
+			multires_.get_peak( channel, peak_.frequency, peak_.db );
+		} else {
+			// tracked per frame on the analysis side, already interpolated
+			const fft_processor& fft = stft_.get_processor( );
+			const spectral_peak& top = averager_.get_peak( );
+			peak_.frequency          = top.bin * static_cast< float >( fft.get_sample_rate( ) ) / static_cast< float >( fft.get_fft_size( ) );
+			peak_.db                 = top.db;
 		}
 
 		// calculate screen pos
@@ -186,6 +290,8 @@ namespace pm
 		// find peak for tooltip
 		find_peak( canvas_pos, canvas_size );
 
+		update_band_maps( );
+
 		// draw based on mode
 		if ( display_mode_ == spectrum_display_mode::color_bars || display_mode_ == spectrum_display_mode::both ) {
 			draw_color_bars( draw_list, canvas_pos, canvas_size );
@@ -204,16 +310,30 @@ namespace pm
 
 	void spectrum::draw_grid( ImDrawList* draw_list, ImVec2 pos, ImVec2 size )
 	{
-		// frequency markers
-		float freqs[]        = { 100.0f, 1000.0f, 10000.0f };
-		const char* labels[] = { "100Hz", "1kHz", "10kHz" };
+		// frequency markers, evenly spaced across the zoom window
+		if ( zoom_enabled_ ) {
+			for ( int i = 1; i < 4; ++i ) {
+				float t    = static_cast< float >( i ) / 4.0f;
+				float x    = pos.x + t * size.x;
+				float freq = position_to_freq( t );
+
+				char label[ 32 ];
+				snprintf( label, sizeof( label ), "%.1fHz", freq );
+
+				draw_list->AddLine( ImVec2( x, pos.y ), ImVec2( x, pos.y + size.y ), IM_COL32( 40, 40, 50, 255 ) );
+				draw_list->AddText( ImVec2( x + 2, pos.y + 2 ), IM_COL32( 80, 80, 100, 255 ), label );
+			}
+		} else {
+			float freqs[]        = { 100.0f, 1000.0f, 10000.0f };
+			const char* labels[] = { "100Hz", "1kHz", "10kHz" };
 
-		for ( int i = 0; i < 3; ++i ) {
-			float t = freq_to_position( freqs[ i ] );
-			float x = pos.x + t * size.x;
+			for ( int i = 0; i < 3; ++i ) {
+				float t = freq_to_position( freqs[ i ] );
+				float x = pos.x + t * size.x;
 
-			draw_list->AddLine( ImVec2( x, pos.y ), ImVec2( x, pos.y + size.y ), IM_COL32( 40, 40, 50, 255 ) );
-			draw_list->AddText( ImVec2( x + 2, pos.y + 2 ), IM_COL32( 80, 80, 100, 255 ), labels[ i ] );
+				draw_list->AddLine( ImVec2( x, pos.y ), ImVec2( x, pos.y + size.y ), IM_COL32( 40, 40, 50, 255 ) );
+				draw_list->AddText( ImVec2( x + 2, pos.y + 2 ), IM_COL32( 80, 80, 100, 255 ), labels[ i ] );
+			}
 		}
 
 		// db markers
@@ -226,16 +346,14 @@ namespace pm
 
 	void spectrum::draw_color_bars( ImDrawList* draw_list, ImVec2 pos, ImVec2 size )
 	{
-		const int bar_count = 128;
-		float bar_width     = size.x / bar_count;
+		float bar_width = size.x / k_bar_count;
 
-		for ( int i = 0; i < bar_count; ++i ) {
-			float t0    = static_cast< float >( i ) / bar_count;
-			float t1    = static_cast< float >( i + 1 ) / bar_count;
-			float freq0 = position_to_freq( t0 );
-			float freq1 = position_to_freq( t1 );
+		reduce_bands( bar_map_, bar_start_, bar_end_, bar_db_ );
 
-			float db         = get_band_magnitude_db( freq0, freq1 );
+		for ( size_t i = 0; i < k_bar_count; ++i ) {
+			float t0 = static_cast< float >( i ) / k_bar_count;
+
+			float db         = bar_db_[ i ];
 			float normalized = ( db - min_db_ ) / ( max_db_ - min_db_ );
 			normalized       = std::max( 0.0f, std::min( 1.0f, normalized ) );
 
@@ -258,16 +376,15 @@ namespace pm
 
 	void spectrum::draw_fft_line( ImDrawList* draw_list, ImVec2 pos, ImVec2 size )
 	{
-		const int points_count = 256;
 		std::vector< ImVec2 > points;
-		points.reserve( points_count );
+		points.reserve( k_line_points );
+
+		reduce_bands( line_map_, line_start_, line_end_, line_db_ );
 
-		for ( int i = 0; i < points_count; ++i ) {
-			float t         = static_cast< float >( i ) / ( points_count - 1 );
-			float freq      = position_to_freq( t );
-			float freq_next = position_to_freq( t + 1.0f / points_count );
+		for ( size_t i = 0; i < k_line_points; ++i ) {
+			float t = static_cast< float >( i ) / ( k_line_points - 1 );
 
-			float db         = get_band_magnitude_db( freq, freq_next );
+			float db         = line_db_[ i ];
 			float normalized = ( db - min_db_ ) / ( max_db_ - min_db_ );
 			normalized       = std::max( 0.0f, std::min( 1.0f, normalized ) );
 
@@ -284,7 +401,14 @@ namespace pm
 
 	void spectrum::draw_peak_tooltip( ImDrawList* draw_list, ImVec2 pos, ImVec2 size )
 	{
-		std::string note_str = freq_to_note_string( peak_.frequency );
+		// the pitch engine only sees stft frames. zoom and multi-resolution
+		// views name the note of the peak they show
+		std::string note_str;
+		if ( zoom_enabled_ || source_ == spectrum_source::multi_resolution ) {
+			note_str = freq_to_note_string( peak_.frequency );
+		} else if ( pitch_.get_estimate( ).voiced ) {
+			note_str = freq_to_note_string( pitch_.get_estimate( ).frequency );
+		}
 
 		char buf[ 64 ];
 		if ( note_str.empty( ) ) {
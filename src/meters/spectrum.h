@@ -1,9 +1,15 @@
 #pragma once
 
-#include "../dsp/fft_processor.h"
+#include "../dsp/band_map.h"
+#include "../dsp/multires_analyzer.h"
+#include "../dsp/pitch_detector.h"
+#include "../dsp/spectral_averager.h"
+#include "../dsp/stft.h"
+#include "../dsp/zoom_fft.h"
 #include "../gui/meter_panel.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace pm
 {
@@ -40,6 +46,7 @@ namespace pm
 		spectrum( );
 
 		void update( const sample_t* samples, size_t frame_count, int channels ) override;
+		void set_sample_rate( int sample_rate ) override;
 		void render( ) override;
 
 		// settings
@@ -55,10 +62,34 @@ namespace pm
 		void set_channel( spectrum_channel channel )
 		{
 			channel_ = channel;
+			averager_.reset( );
+			pitch_.reset( );
+			zoom_.set_channel( get_fft_channel( ) );
 		}
-		void set_smoothing( float smoothing )
+		void set_source( spectrum_source source )
 		{
-			fft_.set_smoothing( smoothing );
+			source_ = source;
+		}
+		// ballistics in real time units, independent of hop and fft size. the
+		// multi-resolution source follows the exponential time constant
+		void set_averaging( const averaging_settings& settings )
+		{
+			averager_.configure( settings );
+			multires_.set_time_constant( settings.time_ms );
+		}
+		void set_frame_rate( float frames_per_second )
+		{
+			stft_.set_frame_rate( frames_per_second );
+		}
+		// linear view of [center - span / 2, center + span / 2] at ~0.1 Hz
+		// resolution for 200 Hz, from zoom_fft rather than a giant transform.
+		// overrides the source and scale while enabled. a frame spans
+		// fft_size / zoom rate seconds, so the view updates every few seconds
+		void set_zoom( bool enabled );
+		void set_zoom_window( float center_hz, float span_hz );
+		bool is_zoomed( ) const
+		{
+			return zoom_enabled_;
 		}
 		void set_min_db( float db )
 		{
@@ -74,7 +105,25 @@ namespace pm
 		}
 
 	private:
-		fft_processor fft_;
+		// 4096-point frames every 1024 samples (75% overlap, ~47 frames/s at 48 kHz)
+		stft stft_;
+		multires_analyzer multires_;
+
+		// fed the selected channel's raw magnitudes once per stft frame, and
+		// tracks the tooltip peak on the spectrum the bars are drawn from
+		spectral_averager averager_;
+
+		// run on every stft frame of the selected channel, names the note in
+		// the peak tooltip instead of the loudest bin (often a harmonic)
+		pitch_detector pitch_;
+		std::vector< sample_t > pitch_input_;
+
+		zoom_fft zoom_;
+		bool zoom_enabled_ = false;
+		float zoom_start_  = 900.0f;
+		float zoom_end_    = 1100.0f;
+
+		spectrum_source source_             = spectrum_source::fft;
 		spectrum_display_mode display_mode_ = spectrum_display_mode::both;
 		spectrum_scale scale_               = spectrum_scale::logarithmic;
 		spectrum_channel channel_           = spectrum_channel::left;
@@ -82,16 +131,30 @@ namespace pm
 		float max_db_                       = 0.0f;
 		bool show_peak_info_                = true;
 
-		std::vector< sample_t > left_buffer_;
-		std::vector< sample_t > right_buffer_;
 		peak_info peak_;
 
+		static constexpr size_t k_bar_count   = 128;
+		static constexpr size_t k_line_points = 256;
+
+		// band edges in Hz and their bin tables, rebuilt when the fft size,
+		// sample rate or scale changes. a line point spans [t, t + 1 / points)
+		band_map bar_map_;
+		band_map line_map_;
+		spectrum_scale band_scale_ = spectrum_scale::logarithmic;
+		bool bands_dirty_          = true;
+		std::vector< float > bar_start_, bar_end_, bar_db_;
+		std::vector< float > line_start_, line_end_, line_db_;
+
+		fft_channel get_fft_channel( ) const;
+		void update_pitch( );
+		void update_band_maps( );
+		void reduce_bands( band_map& map, const std::vector< float >& start, const std::vector< float >& end, std::vector< float >& band_db );
+
 		// scale conversion
 		float position_to_freq( float pos ) const;
 		float freq_to_position( float freq ) const;
 
 		// rendering
-		float get_band_magnitude_db( float freq_start, float freq_end ) const;
 		void find_peak( ImVec2 pos, ImVec2 size );
 		void draw_grid( ImDrawList* draw_list, ImVec2 pos, ImVec2 size );
 		void draw_color_bars( ImDrawList* draw_list, ImVec2 pos, ImVec2 size );
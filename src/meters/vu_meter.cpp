@@ -13,32 +13,23 @@ namespace pm
 		integration_coeff_ = 1.0f - std::exp( -1.0f / ( 0.3f * 60.0f ) );
 	}
 
-	void vu_meter::update( const sample_t* samples, size_t frame_count, int channels )
+	void vu_meter::update( const sample_t*, size_t, int )
 	{
-		if ( channels < 1 )
+		// everything comes from the shared level statistics
+	}
+
+	void vu_meter::update_levels( const level_stats& levels )
+	{
+		if ( levels.channels < 1 )
 			return;
 
-		// calculate RMS
-		float sum_l = 0.0f, sum_r = 0.0f;
-		float max_l = 0.0f, max_r = 0.0f;
-
-		for ( size_t i = 0; i < frame_count; ++i ) {
-			float l = samples[ i * channels ];
-			sum_l += l * l;
-			max_l = std::max( max_l, std::abs( l ) );
-
-			if ( channels >= 2 ) {
-				float r = samples[ i * channels + 1 ];
-				sum_r += r * r;
-				max_r = std::max( max_r, std::abs( r ) );
-			} else {
-				sum_r = sum_l;
-				max_r = max_l;
-			}
-		}
+		// mono shows the same signal on both needles
+		const int right = ( levels.channels >= 2 ) ? 1 : 0;
 
-		float rms_l = std::sqrt( sum_l / frame_count );
-		float rms_r = std::sqrt( sum_r / frame_count );
+		float rms_l = levels.get_rms( 0 );
+		float rms_r = levels.get_rms( right );
+		float max_l = levels.get_peak( 0 );
+		float max_r = levels.get_peak( right );
 
 		// convert to dB
 		float db_l      = ( rms_l > 1e-10f ) ? 20.0f * std::log10( rms_l ) : -60.0f;
@@ -11,6 +11,7 @@ namespace pm
 		vu_meter( );
 
 		void update( const sample_t* samples, size_t frame_count, int channels ) override;
+		void update_levels( const level_stats& levels ) override;
 		void render( ) override;
 
 		void set_calibration( float db )
@@ -0,0 +1,147 @@
+// self-check of the post-FFT dB kernels against std::log10
+//
+// fast_log2 is held to its documented bound (1e-5 absolute in log2, so under
+// 1e-4 dB) over 1e-30..1e30 on every instruction set path the host can run,
+// with the mantissa range swept exhaustively. the dispatched dB kernels are
+// then compared with 10 * log10( power ) and 20 * log10( magnitude ) over the
+// range their floors and float squares leave them. exits non-zero on failure
+
+#include "dsp/simd.h"
+#include "dsp/spectral_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+	constexpr double k_max_log2_error = 1e-5;
+	constexpr double k_max_db_error   = 1e-4;
+
+	const double k_log10_2 = std::log10( 2.0 );
+
+	// every path the host can run: scalar always, the detected one, and on
+	// avx2 hosts the sse2 baseline underneath it
+	std::vector< pm::simd::isa > supported_isas( )
+	{
+		std::vector< pm::simd::isa > isas = { pm::simd::isa::scalar };
+		const pm::simd::isa best          = pm::simd::get_isa( );
+		if ( best == pm::simd::isa::avx2 ) {
+			isas.push_back( pm::simd::isa::sse2 );
+		}
+		if ( best != pm::simd::isa::scalar ) {
+			isas.push_back( best );
+		}
+		return isas;
+	}
+
+	// log-spaced over the documented range, then every float the polynomial
+	// sees after range reduction, [sqrt(0.5), sqrt(2))
+	std::vector< float > log2_inputs( )
+	{
+		constexpr size_t k_steps = 1 << 20;
+
+		std::vector< float > inputs;
+		inputs.reserve( k_steps + ( 1 << 23 ) );
+		for ( size_t i = 0; i < k_steps; ++i ) {
+			const double t = static_cast< double >( i ) / static_cast< double >( k_steps - 1 );
+			inputs.push_back( static_cast< float >( std::pow( 10.0, -30.0 + 60.0 * t ) ) );
+		}
+		for ( float x = std::sqrt( 0.5f ); x < std::sqrt( 2.0f ); x = std::nextafter( x, 2.0f ) ) {
+			inputs.push_back( x );
+		}
+		return inputs;
+	}
+
+	bool check_fast_log2( pm::simd::isa isa, const std::vector< float >& inputs )
+	{
+		std::vector< float > out( inputs.size( ) );
+		if ( !pm::fast_log2_array( isa, inputs.data( ), inputs.size( ), out.data( ) ) ) {
+			printf( "%-8s fast_log2        not compiled in\n", pm::simd::get_isa_name( isa ) );
+			return false;
+		}
+
+		double max_error = 0.0;
+		float worst      = 0.0f;
+		for ( size_t i = 0; i < inputs.size( ); ++i ) {
+			const double expected = std::log10( static_cast< double >( inputs[ i ] ) ) / k_log10_2;
+			const double error    = std::abs( static_cast< double >( out[ i ] ) - expected );
+			if ( !( error <= max_error ) ) {
+				max_error = error;
+				worst     = inputs[ i ];
+			}
+		}
+
+		const bool ok = max_error < k_max_log2_error;
+		printf( "%-8s fast_log2        max error %.3g (%.3g dB) at %g  %s\n", pm::simd::get_isa_name( isa ), max_error,
+		        20.0 * k_log10_2 * max_error, worst, ok ? "ok" : "FAILED" );
+		return ok;
+	}
+
+	// power above the 1e-20 floor up to the documented 1e30
+	bool check_power_to_magnitude_db( )
+	{
+		constexpr size_t k_count = 1 << 16;
+
+		std::vector< float > power( k_count ), magnitudes( k_count ), db( k_count );
+		for ( size_t i = 0; i < k_count; ++i ) {
+			const double t = static_cast< double >( i ) / static_cast< double >( k_count - 1 );
+			power[ i ]     = static_cast< float >( std::pow( 10.0, -19.0 + 49.0 * t ) );
+		}
+
+		pm::power_to_magnitude_db( power.data( ), k_count, -1000.0f, magnitudes.data( ), db.data( ) );
+
+		double max_error = 0.0;
+		for ( size_t i = 0; i < k_count; ++i ) {
+			const double expected = 10.0 * std::log10( static_cast< double >( power[ i ] ) );
+			max_error             = std::max( max_error, std::abs( static_cast< double >( db[ i ] ) - expected ) );
+		}
+
+		const bool ok = max_error < k_max_db_error;
+		printf( "%-8s power_to_mag_db  max error %.3g dB  %s\n", pm::simd::get_isa_name( pm::simd::get_isa( ) ), max_error, ok ? "ok" : "FAILED" );
+		return ok;
+	}
+
+	// magnitude above the 1e-10 floor, below where re^2 + im^2 overflows
+	bool check_magnitude_db( )
+	{
+		constexpr size_t k_count = 1 << 16;
+
+		std::vector< float > bins( k_count * 2 ), magnitudes( k_count, 0.0f ), db( k_count );
+		for ( size_t i = 0; i < k_count; ++i ) {
+			const double t     = static_cast< double >( i ) / static_cast< double >( k_count - 1 );
+			const double mag   = std::pow( 10.0, -9.0 + 27.0 * t );
+			const double phase = static_cast< double >( i ) * 0.1;
+			bins[ i * 2 ]      = static_cast< float >( mag * std::cos( phase ) );
+			bins[ i * 2 + 1 ]  = static_cast< float >( mag * std::sin( phase ) );
+		}
+
+		pm::magnitude_db( bins.data( ), k_count, 1.0f, 0.0f, -1000.0f, magnitudes.data( ), db.data( ) );
+
+		double max_error = 0.0;
+		for ( size_t i = 0; i < k_count; ++i ) {
+			const double expected = 20.0 * std::log10( std::hypot( static_cast< double >( bins[ i * 2 ] ), static_cast< double >( bins[ i * 2 + 1 ] ) ) );
+			max_error             = std::max( max_error, std::abs( static_cast< double >( db[ i ] ) - expected ) );
+		}
+
+		const bool ok = max_error < k_max_db_error;
+		printf( "%-8s magnitude_db     max error %.3g dB  %s\n", pm::simd::get_isa_name( pm::simd::get_isa( ) ), max_error, ok ? "ok" : "FAILED" );
+		return ok;
+	}
+
+} // namespace
+
+int main( )
+{
+	const std::vector< float > inputs = log2_inputs( );
+
+	bool ok = true;
+	for ( pm::simd::isa isa : supported_isas( ) ) {
+		ok = check_fast_log2( isa, inputs ) && ok;
+	}
+	ok = check_power_to_magnitude_db( ) && ok;
+	ok = check_magnitude_db( ) && ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,423 @@
+// batch loudness scanner
+//
+// walks the given files and directories and measures every WAVE file found:
+// BS.1770 integrated loudness, EBU Tech 3342 loudness range, true peak and
+// the maximum momentary / short-term loudness. one CSV row or JSON object is
+// written per file, in path order. files are spread over a work-stealing
+// pool, one file per task, so a run is bound by disk bandwidth once there
+// are enough cores to keep up with it
+//
+// usage: loudness-scan [-j threads] [-f csv|json] [-o output] [-t 4|8] path...
+
+#include "dsp/loudness.h"
+#include "dsp/true_peak.h"
+#include "wav_reader.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	namespace fs     = std::filesystem;
+	using clock_type = std::chrono::steady_clock;
+
+	// frames decoded and measured per read, large enough that the reads
+	// stream and small enough to stay in L2 as floats
+	constexpr size_t k_read_frames = 16384;
+
+	// WAVE_FORMAT_EXTENSIBLE speaker bits
+	constexpr uint32_t k_speaker_lfe       = 0x8;
+	constexpr uint32_t k_speaker_surrounds = 0x10 | 0x20 | 0x200 | 0x400; // back and side left / right
+	constexpr float k_surround_weight      = 1.41f;
+
+	struct options {
+		size_t threads     = 0; // 0 = one per hardware thread
+		bool json          = false;
+		const char* output = nullptr;
+		int oversampling   = 4;
+		std::vector< std::string > paths;
+	};
+
+	struct file_result {
+		std::string path;
+		uint64_t bytes = 0;
+
+		std::string error; // empty on success
+		int sample_rate = 0;
+		int channels    = 0;
+		double duration = 0.0;
+
+		// the meters' -100 floor for silence
+		float integrated     = -100.0f;
+		float range          = 0.0f;
+		float true_peak      = -100.0f;
+		float max_momentary  = -100.0f;
+		float max_short_term = -100.0f;
+	};
+
+	// BS.1770 channel weights from a WAVE channel mask, where channels appear
+	// in ascending speaker bit order. empty when the mask doesn't describe
+	// every channel, in which case the WAVE-order defaults apply
+	std::vector< float > weights_from_mask( uint32_t mask, int channels )
+	{
+		std::vector< float > weights;
+		for ( uint32_t bit = 1; bit != 0 && static_cast< int >( weights.size( ) ) < channels; bit <<= 1 ) {
+			if ( !( mask & bit ) )
+				continue;
+			if ( bit == k_speaker_lfe ) {
+				weights.push_back( 0.0f );
+			} else {
+				weights.push_back( ( bit & k_speaker_surrounds ) ? k_surround_weight : 1.0f );
+			}
+		}
+
+		if ( static_cast< int >( weights.size( ) ) != channels ) {
+			weights.clear( );
+		}
+		return weights;
+	}
+
+	// one per worker, reused from file to file
+	struct analyzer {
+		pm::wav_reader reader;
+		pm::lufs_meter lufs;
+		pm::true_peak_meter true_peak;
+		std::vector< float > buffer;
+
+		explicit analyzer( int oversampling ) : true_peak( oversampling ) { }
+
+		void analyze( file_result& result )
+		{
+			if ( !reader.open( result.path.c_str( ) ) ) {
+				result.error = reader.get_error( );
+				return;
+			}
+
+			const int channels = reader.get_channels( );
+			result.sample_rate = reader.get_sample_rate( );
+			result.channels    = channels;
+
+			const std::vector< float > weights = weights_from_mask( reader.get_channel_mask( ), channels );
+			lufs.set_channel_weights( weights.empty( ) ? nullptr : weights.data( ), channels );
+			lufs.set_sample_rate( result.sample_rate );
+			true_peak.reset( );
+
+			buffer.resize( k_read_frames * static_cast< size_t >( channels ) );
+
+			uint64_t frames = 0;
+			for ( ;; ) {
+				const size_t count = reader.read( buffer.data( ), k_read_frames );
+				if ( count == 0 )
+					break;
+
+				lufs.process( buffer.data( ), count, channels );
+				true_peak.process( buffer.data( ), count, channels );
+				frames += count;
+			}
+			const bool truncated    = reader.is_truncated( );
+			const uint64_t declared = reader.get_frame_count( );
+			reader.close( );
+
+			// measurements over part of a file would pass for the whole one
+			if ( truncated ) {
+				char message[ 96 ];
+				std::snprintf( message, sizeof( message ), "truncated data chunk: %llu of %llu frames", static_cast< unsigned long long >( frames ),
+				               static_cast< unsigned long long >( declared ) );
+				result.error = message;
+				return;
+			}
+
+			result.duration       = static_cast< double >( frames ) / result.sample_rate;
+			result.integrated     = lufs.get_integrated( );
+			result.range          = lufs.get_loudness_range( );
+			result.true_peak      = true_peak.get_max_db( );
+			result.max_momentary  = lufs.get_max_momentary( );
+			result.max_short_term = lufs.get_max_short_term( );
+		}
+	};
+
+	// per-worker deques. a worker takes from the front of its own deque and,
+	// once that runs dry, steals from the back of the others. tasks come in
+	// largest first, so owners start on the long files and thieves mop up
+	// the short ones, which keeps the end of a run balanced. the calling
+	// thread is worker 0
+	void run_work_stealing( const std::vector< size_t >& tasks, size_t thread_count, const std::function< void( size_t, size_t ) >& job )
+	{
+		struct queue {
+			std::mutex mutex;
+			std::deque< size_t > items;
+		};
+		std::vector< queue > queues( thread_count );
+		for ( size_t i = 0; i < tasks.size( ); ++i ) {
+			queues[ i % thread_count ].items.push_back( tasks[ i ] );
+		}
+
+		// no task spawns another, so once every deque is empty the work is done
+		auto next = [ & ]( size_t worker, size_t& task ) {
+			for ( size_t k = 0; k < thread_count; ++k ) {
+				queue& victim = queues[ ( worker + k ) % thread_count ];
+				std::lock_guard< std::mutex > lock( victim.mutex );
+				if ( victim.items.empty( ) )
+					continue;
+
+				if ( k == 0 ) {
+					task = victim.items.front( );
+					victim.items.pop_front( );
+				} else {
+					task = victim.items.back( );
+					victim.items.pop_back( );
+				}
+				return true;
+			}
+			return false;
+		};
+
+		auto work = [ & ]( size_t worker ) {
+			size_t task;
+			while ( next( worker, task ) ) {
+				job( worker, task );
+			}
+		};
+
+		std::vector< std::thread > threads;
+		for ( size_t i = 1; i < thread_count; ++i ) {
+			threads.emplace_back( work, i );
+		}
+		work( 0 );
+		for ( auto& thread : threads ) {
+			thread.join( );
+		}
+	}
+
+	bool is_wave_file( const fs::path& path )
+	{
+		std::string extension = path.extension( ).string( );
+		std::transform( extension.begin( ), extension.end( ), extension.begin( ), []( unsigned char c ) { return std::tolower( c ); } );
+		return extension == ".wav" || extension == ".wave" || extension == ".bwf" || extension == ".rf64";
+	}
+
+	void add_file( const std::string& path, std::vector< file_result >& files )
+	{
+		// only used to schedule the largest files first, a failure here shows
+		// up as an open error later
+		std::error_code error;
+		const uintmax_t size = fs::file_size( path, error );
+
+		file_result result;
+		result.path  = path;
+		result.bytes = error ? 0 : size;
+		files.push_back( std::move( result ) );
+	}
+
+	// files named on the command line are taken as they are, directories are
+	// searched recursively for WAVE files
+	void collect_files( const std::string& path, std::vector< file_result >& files )
+	{
+		std::error_code error;
+		if ( !fs::is_directory( path, error ) ) {
+			add_file( path, files );
+			return;
+		}
+
+		const auto flags = fs::directory_options::skip_permission_denied;
+		for ( fs::recursive_directory_iterator it( path, flags, error ), end; !error && it != end; it.increment( error ) ) {
+			std::error_code status;
+			if ( it->is_regular_file( status ) && is_wave_file( it->path( ) ) ) {
+				add_file( it->path( ).string( ), files );
+			}
+		}
+
+		if ( error ) {
+			std::fprintf( stderr, "%s: %s\n", path.c_str( ), error.message( ).c_str( ) );
+		}
+	}
+
+	void write_csv_field( std::FILE* out, const std::string& text )
+	{
+		if ( text.find_first_of( ",\"\r\n" ) == std::string::npos ) {
+			std::fputs( text.c_str( ), out );
+			return;
+		}
+
+		std::fputc( '"', out );
+		for ( char c : text ) {
+			if ( c == '"' ) {
+				std::fputc( '"', out );
+			}
+			std::fputc( c, out );
+		}
+		std::fputc( '"', out );
+	}
+
+	void write_json_string( std::FILE* out, const std::string& text )
+	{
+		std::fputc( '"', out );
+		for ( unsigned char c : text ) {
+			if ( c == '"' || c == '\\' ) {
+				std::fputc( '\\', out );
+				std::fputc( c, out );
+			} else if ( c < 0x20 ) {
+				std::fprintf( out, "\\u%04x", c );
+			} else {
+				std::fputc( c, out );
+			}
+		}
+		std::fputc( '"', out );
+	}
+
+	void write_csv( std::FILE* out, const std::vector< file_result >& results )
+	{
+		std::fputs( "path,sample_rate,channels,duration_s,integrated_lufs,loudness_range_lu,true_peak_dbtp,max_momentary_lufs,max_short_term_lufs,error\n",
+		            out );
+
+		for ( const auto& r : results ) {
+			write_csv_field( out, r.path );
+			if ( r.error.empty( ) ) {
+				std::fprintf( out, ",%d,%d,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,\n", r.sample_rate, r.channels, r.duration, r.integrated, r.range, r.true_peak,
+				              r.max_momentary, r.max_short_term );
+			} else {
+				std::fputs( ",,,,,,,,,", out );
+				write_csv_field( out, r.error );
+				std::fputc( '\n', out );
+			}
+		}
+	}
+
+	void write_json( std::FILE* out, const std::vector< file_result >& results )
+	{
+		std::fputs( "[\n", out );
+
+		for ( size_t i = 0; i < results.size( ); ++i ) {
+			const auto& r = results[ i ];
+
+			std::fputs( "  { \"path\": ", out );
+			write_json_string( out, r.path );
+			if ( r.error.empty( ) ) {
+				std::fprintf( out,
+				              ", \"sample_rate\": %d, \"channels\": %d, \"duration_s\": %.3f, \"integrated_lufs\": %.2f, \"loudness_range_lu\": %.2f, "
+				              "\"true_peak_dbtp\": %.2f, \"max_momentary_lufs\": %.2f, \"max_short_term_lufs\": %.2f }",
+				              r.sample_rate, r.channels, r.duration, r.integrated, r.range, r.true_peak, r.max_momentary, r.max_short_term );
+			} else {
+				std::fputs( ", \"error\": ", out );
+				write_json_string( out, r.error );
+				std::fputs( " }", out );
+			}
+			std::fputs( ( i + 1 < results.size( ) ) ? ",\n" : "\n", out );
+		}
+
+		std::fputs( "]\n", out );
+	}
+
+	void print_usage( )
+	{
+		std::fputs( "usage: loudness-scan [options] path...\n"
+		            "  -j N       worker threads (default: one per hardware thread)\n"
+		            "  -f FORMAT  csv or json (default: csv)\n"
+		            "  -o FILE    write the report to FILE instead of stdout\n"
+		            "  -t N       true-peak oversampling, 4 or 8 (default: 4)\n",
+		            stderr );
+	}
+
+	bool parse_options( int argc, char** argv, options& opts )
+	{
+		for ( int i = 1; i < argc; ++i ) {
+			const char* arg = argv[ i ];
+			const bool has_value = i + 1 < argc;
+
+			if ( std::strcmp( arg, "-j" ) == 0 && has_value ) {
+				opts.threads = static_cast< size_t >( std::max( std::atoi( argv[ ++i ] ), 1 ) );
+			} else if ( std::strcmp( arg, "-f" ) == 0 && has_value ) {
+				const char* format = argv[ ++i ];
+				if ( std::strcmp( format, "json" ) == 0 ) {
+					opts.json = true;
+				} else if ( std::strcmp( format, "csv" ) != 0 ) {
+					return false;
+				}
+			} else if ( std::strcmp( arg, "-o" ) == 0 && has_value ) {
+				opts.output = argv[ ++i ];
+			} else if ( std::strcmp( arg, "-t" ) == 0 && has_value ) {
+				opts.oversampling = std::atoi( argv[ ++i ] );
+			} else if ( arg[ 0 ] == '-' && arg[ 1 ] != '\0' ) {
+				return false;
+			} else {
+				opts.paths.push_back( arg );
+			}
+		}
+		return !opts.paths.empty( );
+	}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+	options opts;
+	if ( !parse_options( argc, argv, opts ) ) {
+		print_usage( );
+		return 1;
+	}
+
+	std::vector< file_result > results;
+	for ( const auto& path : opts.paths ) {
+		collect_files( path, results );
+	}
+	std::sort( results.begin( ), results.end( ), []( const file_result& a, const file_result& b ) { return a.path < b.path; } );
+
+	size_t threads = opts.threads ? opts.threads : std::max< size_t >( std::thread::hardware_concurrency( ), 1 );
+	threads        = std::max< size_t >( std::min( threads, results.size( ) ), 1 );
+
+	// largest first, see run_work_stealing( )
+	std::vector< size_t > order( results.size( ) );
+	for ( size_t i = 0; i < order.size( ); ++i ) {
+		order[ i ] = i;
+	}
+	std::stable_sort( order.begin( ), order.end( ), [ & ]( size_t a, size_t b ) { return results[ a ].bytes > results[ b ].bytes; } );
+
+	std::vector< std::unique_ptr< analyzer > > analyzers;
+	for ( size_t i = 0; i < threads; ++i ) {
+		analyzers.push_back( std::make_unique< analyzer >( opts.oversampling ) );
+	}
+
+	auto start = clock_type::now( );
+	run_work_stealing( order, threads, [ & ]( size_t worker, size_t task ) { analyzers[ worker ]->analyze( results[ task ] ); } );
+	double elapsed = std::chrono::duration< double >( clock_type::now( ) - start ).count( );
+
+	std::FILE* out = opts.output ? std::fopen( opts.output, "w" ) : stdout;
+	if ( !out ) {
+		std::fprintf( stderr, "cannot write %s\n", opts.output );
+		return 1;
+	}
+
+	if ( opts.json ) {
+		write_json( out, results );
+	} else {
+		write_csv( out, results );
+	}
+	if ( out != stdout ) {
+		std::fclose( out );
+	}
+
+	uint64_t bytes = 0;
+	size_t failed  = 0;
+	for ( const auto& r : results ) {
+		bytes += r.bytes;
+		failed += r.error.empty( ) ? 0 : 1;
+	}
+
+	const double megabytes = static_cast< double >( bytes ) / ( 1024.0 * 1024.0 );
+	std::fprintf( stderr, "%zu files (%zu failed), %.1f MiB in %.2f s, %.1f MiB/s on %zu threads\n", results.size( ), failed, megabytes, elapsed,
+	              elapsed > 0.0 ? megabytes / elapsed : 0.0, threads );
+
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,277 @@
+#include "wav_reader.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined( __linux__ )
+#include <fcntl.h>
+#endif
+#if !defined( _WIN32 )
+#include <sys/types.h> // off_t for fseeko
+#endif
+
+namespace pm
+{
+
+	static constexpr uint16_t k_format_pcm        = 0x0001;
+	static constexpr uint16_t k_format_float      = 0x0003;
+	static constexpr uint16_t k_format_extensible = 0xfffe;
+
+	// fmt chunks are 16..40 bytes, anything much larger is not a WAVE header
+	static constexpr uint64_t k_max_format_size = 1024;
+
+	// a 32-bit RIFF size field of all ones means "see ds64" in RF64, and is
+	// what streaming writers leave behind when they never patch the header
+	static constexpr uint32_t k_size_unknown = 0xffffffff;
+
+	// the file is little endian, as are all targets
+	static uint16_t read_u16( const uint8_t* p )
+	{
+		return static_cast< uint16_t >( p[ 0 ] | ( p[ 1 ] << 8 ) );
+	}
+
+	static uint32_t read_u32( const uint8_t* p )
+	{
+		return static_cast< uint32_t >( p[ 0 ] ) | ( static_cast< uint32_t >( p[ 1 ] ) << 8 ) | ( static_cast< uint32_t >( p[ 2 ] ) << 16 ) |
+		       ( static_cast< uint32_t >( p[ 3 ] ) << 24 );
+	}
+
+	static uint64_t read_u64( const uint8_t* p )
+	{
+		return static_cast< uint64_t >( read_u32( p ) ) | ( static_cast< uint64_t >( read_u32( p + 4 ) ) << 32 );
+	}
+
+	wav_reader::~wav_reader( )
+	{
+		close( );
+	}
+
+	void wav_reader::close( )
+	{
+		if ( file_ ) {
+			std::fclose( file_ );
+			file_ = nullptr;
+		}
+		frames_remaining_ = 0;
+	}
+
+	bool wav_reader::fail( const char* message )
+	{
+		error_ = message;
+		close( );
+		return false;
+	}
+
+	bool wav_reader::open( const char* path )
+	{
+		close( );
+		error_.clear( );
+		sample_rate_  = 0;
+		channels_     = 0;
+		bits_         = 0;
+		frame_bytes_  = 0;
+		channel_mask_ = 0;
+		frame_count_  = 0;
+		truncated_    = false;
+
+		file_ = std::fopen( path, "rb" );
+		if ( !file_ )
+			return fail( "cannot open file" );
+
+#if defined( __linux__ )
+		// whole-file sequential scan, let the kernel read ahead aggressively
+		posix_fadvise( fileno( file_ ), 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+		uint8_t header[ 12 ];
+		if ( std::fread( header, 1, sizeof( header ), file_ ) != sizeof( header ) )
+			return fail( "file too short" );
+
+		const bool rf64 = std::memcmp( header, "RF64", 4 ) == 0;
+		if ( ( !rf64 && std::memcmp( header, "RIFF", 4 ) != 0 ) || std::memcmp( header + 8, "WAVE", 4 ) != 0 )
+			return fail( "not a WAVE file" );
+
+		uint64_t ds64_data_size = 0;
+		bool have_format        = false;
+
+		for ( ;; ) {
+			uint8_t chunk[ 8 ];
+			if ( std::fread( chunk, 1, sizeof( chunk ), file_ ) != sizeof( chunk ) )
+				return fail( "no data chunk" );
+
+			const uint32_t size = read_u32( chunk + 4 );
+
+			if ( std::memcmp( chunk, "data", 4 ) == 0 ) {
+				if ( !have_format )
+					return fail( "data chunk before fmt chunk" );
+
+				uint64_t data_size = size;
+				if ( rf64 && size == k_size_unknown ) {
+					data_size = ds64_data_size;
+				} else if ( size == k_size_unknown ) {
+					data_size = std::numeric_limits< uint64_t >::max( ); // read to the end of the file
+				}
+
+				frames_remaining_ = data_size / frame_bytes_;
+				frame_count_      = ( data_size == std::numeric_limits< uint64_t >::max( ) ) ? 0 : frames_remaining_;
+				return true;
+			}
+
+			if ( std::memcmp( chunk, "fmt ", 4 ) == 0 || ( rf64 && std::memcmp( chunk, "ds64", 4 ) == 0 ) ) {
+				if ( size > k_max_format_size )
+					return fail( "malformed header" );
+
+				std::vector< uint8_t > body( size );
+				if ( std::fread( body.data( ), 1, size, file_ ) != size )
+					return fail( "file too short" );
+				if ( size & 1 ) {
+					std::fgetc( file_ );
+				}
+
+				if ( chunk[ 0 ] == 'd' ) {
+					// riff size, data size, sample count
+					if ( size < 24 )
+						return fail( "malformed ds64 chunk" );
+					ds64_data_size = read_u64( body.data( ) + 8 );
+				} else {
+					if ( !parse_format( body.data( ), size ) )
+						return false;
+					have_format = true;
+				}
+				continue;
+			}
+
+			// skip anything else (LIST, bext, fact, ...), chunks are word aligned.
+			// a chunk can be up to 4 GiB, past what a 32-bit long seeks
+			if ( !skip( static_cast< uint64_t >( size ) + ( size & 1 ) ) )
+				return fail( "no data chunk" );
+		}
+	}
+
+	bool wav_reader::skip( uint64_t bytes )
+	{
+#if defined( _WIN32 )
+		return _fseeki64( file_, static_cast< __int64 >( bytes ), SEEK_CUR ) == 0;
+#else
+		return fseeko( file_, static_cast< off_t >( bytes ), SEEK_CUR ) == 0;
+#endif
+	}
+
+	bool wav_reader::parse_format( const uint8_t* chunk, uint64_t size )
+	{
+		if ( size < 16 )
+			return fail( "malformed fmt chunk" );
+
+		uint16_t format = read_u16( chunk );
+		channels_       = read_u16( chunk + 2 );
+		sample_rate_    = static_cast< int >( read_u32( chunk + 4 ) );
+		const int align = read_u16( chunk + 12 );
+		bits_           = read_u16( chunk + 14 );
+
+		if ( format == k_format_extensible ) {
+			// cbSize, valid bits, channel mask, then the sub-format GUID whose
+			// first two bytes are the actual format tag
+			if ( size < 40 )
+				return fail( "malformed extensible fmt chunk" );
+			channel_mask_ = read_u32( chunk + 20 );
+			format        = read_u16( chunk + 24 );
+		}
+
+		if ( channels_ < 1 || sample_rate_ < 1 )
+			return fail( "malformed fmt chunk" );
+
+		if ( format == k_format_pcm ) {
+			if ( bits_ != 8 && bits_ != 16 && bits_ != 24 && bits_ != 32 )
+				return fail( "unsupported PCM bit depth" );
+			is_float_ = false;
+		} else if ( format == k_format_float ) {
+			if ( bits_ != 32 && bits_ != 64 )
+				return fail( "unsupported float bit depth" );
+			is_float_ = true;
+		} else {
+			return fail( "unsupported sample format" );
+		}
+
+		frame_bytes_ = static_cast< size_t >( channels_ ) * static_cast< size_t >( bits_ / 8 );
+		if ( static_cast< size_t >( align ) != frame_bytes_ )
+			return fail( "malformed fmt chunk" );
+
+		return true;
+	}
+
+	size_t wav_reader::read( sample_t* out, size_t max_frames )
+	{
+		if ( !file_ || frames_remaining_ == 0 )
+			return 0;
+
+		const size_t frames = static_cast< size_t >( std::min< uint64_t >( max_frames, frames_remaining_ ) );
+		raw_.resize( frames * frame_bytes_ );
+
+		const size_t bytes = std::fread( raw_.data( ), 1, raw_.size( ), file_ );
+		const size_t got   = bytes / frame_bytes_;
+
+		// a short read is a truncated file (or the end of an unsized stream),
+		// report what was there and remember that it came up short
+		if ( bytes < raw_.size( ) ) {
+			frames_remaining_ = 0;
+			truncated_        = frame_count_ != 0;
+		} else {
+			frames_remaining_ -= got;
+		}
+
+		decode( raw_.data( ), got * static_cast< size_t >( channels_ ), out );
+		return got;
+	}
+
+	void wav_reader::decode( const uint8_t* raw, size_t samples, sample_t* out ) const
+	{
+		constexpr float k_scale_8  = 1.0f / 128.0f;
+		constexpr float k_scale_16 = 1.0f / 32768.0f;
+		constexpr float k_scale_32 = 1.0f / 2147483648.0f;
+
+		if ( is_float_ ) {
+			if ( bits_ == 32 ) {
+				std::memcpy( out, raw, samples * sizeof( float ) );
+			} else {
+				for ( size_t i = 0; i < samples; ++i ) {
+					double x;
+					std::memcpy( &x, raw + i * 8, sizeof( x ) );
+					out[ i ] = static_cast< float >( x );
+				}
+			}
+			return;
+		}
+
+		switch ( bits_ ) {
+		case 8:
+			for ( size_t i = 0; i < samples; ++i ) {
+				out[ i ] = ( static_cast< int >( raw[ i ] ) - 128 ) * k_scale_8;
+			}
+			break;
+		case 16:
+			for ( size_t i = 0; i < samples; ++i ) {
+				int16_t x;
+				std::memcpy( &x, raw + i * 2, sizeof( x ) );
+				out[ i ] = x * k_scale_16;
+			}
+			break;
+		case 24:
+			// into the top three bytes of an int32, the sign comes along
+			for ( size_t i = 0; i < samples; ++i ) {
+				const uint8_t* p = raw + i * 3;
+				const int32_t x  = static_cast< int32_t >( ( static_cast< uint32_t >( p[ 0 ] ) << 8 ) | ( static_cast< uint32_t >( p[ 1 ] ) << 16 ) |
+				                                           ( static_cast< uint32_t >( p[ 2 ] ) << 24 ) );
+				out[ i ]         = static_cast< float >( x ) * k_scale_32;
+			}
+			break;
+		case 32:
+			for ( size_t i = 0; i < samples; ++i ) {
+				int32_t x;
+				std::memcpy( &x, raw + i * 4, sizeof( x ) );
+				out[ i ] = static_cast< float >( x ) * k_scale_32;
+			}
+			break;
+		}
+	}
+
+} // namespace pm
@@ -0,0 +1,90 @@
+#pragma once
+
+// streaming WAVE / RF64 reader for the offline tools
+
+#include "common/types.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace pm
+{
+
+	// reads PCM (8/16/24/32-bit integer) and IEEE float (32/64-bit) WAVE
+	// files, including WAVE_FORMAT_EXTENSIBLE and RF64 for files past 4 GiB,
+	// and decodes them to interleaved floats a block at a time
+	class wav_reader
+	{
+	public:
+		wav_reader( ) = default;
+		~wav_reader( );
+
+		wav_reader( const wav_reader& )            = delete;
+		wav_reader& operator=( const wav_reader& ) = delete;
+
+		// parses the header and positions at the first sample. false if the
+		// file can't be read or isn't a supported format, see get_error( )
+		bool open( const char* path );
+		void close( );
+
+		int get_sample_rate( ) const
+		{
+			return sample_rate_;
+		}
+		int get_channels( ) const
+		{
+			return channels_;
+		}
+		int get_bits_per_sample( ) const
+		{
+			return bits_;
+		}
+		// speaker positions from WAVE_FORMAT_EXTENSIBLE, 0 if not given
+		uint32_t get_channel_mask( ) const
+		{
+			return channel_mask_;
+		}
+		uint64_t get_frame_count( ) const
+		{
+			return frame_count_;
+		}
+		const std::string& get_error( ) const
+		{
+			return error_;
+		}
+		// the data ended before the frame count the header declared, set once
+		// read( ) reaches the short end. unsized streams are never truncated
+		bool is_truncated( ) const
+		{
+			return truncated_;
+		}
+
+		// decodes up to max_frames frames into out ( max_frames * channels
+		// floats ), returns the frames read, 0 at the end of the data or on a
+		// read error
+		size_t read( sample_t* out, size_t max_frames );
+
+	private:
+		std::FILE* file_ = nullptr;
+
+		int sample_rate_       = 0;
+		int channels_          = 0;
+		int bits_              = 0;
+		bool is_float_         = false;
+		size_t frame_bytes_    = 0;
+		uint32_t channel_mask_ = 0;
+
+		uint64_t frame_count_      = 0;
+		uint64_t frames_remaining_ = 0;
+		bool truncated_            = false;
+
+		std::vector< uint8_t > raw_;
+		std::string error_;
+
+		bool fail( const char* message );
+		bool skip( uint64_t bytes );
+		bool parse_format( const uint8_t* chunk, uint64_t size );
+		void decode( const uint8_t* raw, size_t samples, sample_t* out ) const;
+	};
+
+} // namespace pm